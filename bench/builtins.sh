@@ -0,0 +1,68 @@
+#!/bin/sh
+# Сравнение встроенных утилит с обычным запуском через fork/execve.
+# Каждая команда прогоняется N раз через stdin kubsh в двух режимах:
+# по умолчанию и с KUBSH_NO_BUILTINS=1 (поиск в PATH + fork/execve).
+# Время запуска kubsh (монтирование VFS и sleep(1) в start_users_vfs)
+# измеряется на пустом stdin и вычитается, остаётся цена одной команды.
+#
+# Использование: sh bench/builtins.sh [N]
+
+N=${1:-2000}
+KUBSH=$(cd "$(dirname "$0")/.." && pwd)/kubsh
+WORK=$(mktemp -d)
+trap 'fusermount3 -u "$WORK/users" 2>/dev/null; rm -rf "$WORK"' EXIT
+
+printf 'line one\nline two\nline three\n' > "$WORK/sample.txt"
+
+now_ns() {
+    date +%s%N
+}
+
+# Время запуска kubsh без команд, нс (среднее по трём запускам)
+startup_ns() {
+    cd "$WORK" || exit 1
+    t0=$(now_ns)
+    for _ in 1 2 3; do
+        "$KUBSH" < /dev/null > /dev/null 2>&1
+    done
+    t1=$(now_ns)
+    echo $(( (t1 - t0) / 3 ))
+}
+
+# run_case <имя> <команда>
+run_case() {
+    script="$WORK/script"
+    i=0
+    : > "$script"
+    while [ $i -lt "$N" ]; do
+        printf '%s\n' "$2" >> "$script"
+        i=$((i + 1))
+    done
+
+    cd "$WORK" || exit 1
+
+    t0=$(now_ns)
+    "$KUBSH" < "$script" > /dev/null 2>&1
+    t1=$(now_ns)
+    KUBSH_NO_BUILTINS=1 "$KUBSH" < "$script" > /dev/null 2>&1
+    t2=$(now_ns)
+
+    awk -v name="$1" -v b=$((t1 - t0 - STARTUP)) -v f=$((t2 - t1 - STARTUP)) -v n="$N" \
+        'BEGIN { printf "%-10s %10.1f %10.1f %10.1f\n", name, b / n / 1000, f / n / 1000, (f - b) / n / 1000 }'
+}
+
+STARTUP=$(startup_ns)
+echo "startup: $((STARTUP / 1000)) us per kubsh run (subtracted)"
+
+printf '%-10s %10s %10s %10s\n' "command" "builtin" "fork" "saved"
+printf '%-10s %10s %10s %10s\n' "" "us/cmd" "us/cmd" "us/cmd"
+
+run_case true     "true"
+run_case false    "false"
+run_case test     "test -f sample.txt"
+run_case '['      "[ 1 -lt 2 ]"
+run_case printf   "printf %s\n value"
+run_case basename "basename /usr/local/bin/kubsh"
+run_case dirname  "dirname /usr/local/bin/kubsh"
+run_case cat      "cat sample.txt"
+run_case wc       "wc sample.txt"
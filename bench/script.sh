@@ -0,0 +1,87 @@
+#!/bin/sh
+# Сравнение режима скрипта (с кешем AST и без) со старым циклом по stdin
+# и с /bin/sh. Каждый вариант запускается R раз, выводится среднее время.
+#
+# Использование: sh bench/script.sh [R]
+
+R=${1:-20}
+KUBSH=$(cd "$(dirname "$0")/.." && pwd)/kubsh
+WORK=$(mktemp -d)
+trap 'fusermount3 -u "$WORK/users" 2>/dev/null; rm -rf "$WORK"' EXIT
+
+export XDG_CACHE_HOME="$WORK/cache"
+cd "$WORK" || exit 1
+
+now_ns() {
+    date +%s%N
+}
+
+# run_case <имя> <команда...> — среднее время одного запуска в мкс.
+# Из результата вычитается SUBTRACT_US (по умолчанию 0)
+run_case() {
+    name=$1
+    shift
+    i=0
+    t0=$(now_ns)
+    while [ $i -lt "$R" ]; do
+        "$@" > /dev/null 2>&1 < "${STDIN:-/dev/null}"
+        i=$((i + 1))
+    done
+    t1=$(now_ns)
+    printf '  %-24s %10s us/run\n' "$name" "$(( (t1 - t0) / 1000 / R - ${SUBTRACT_US:-0} ))"
+}
+
+# 1. Линейный скрипт из простых команд: понимают все три варианта
+: > straight.ksh
+i=0
+while [ $i -lt 100 ]; do
+    cat >> straight.ksh <<'LINES'
+true
+test -d /tmp
+[ 1 -lt 2 ]
+basename /usr/local/bin/kubsh
+dirname /usr/local/bin/kubsh
+LINES
+    i=$((i + 1))
+done
+
+echo "straight: 500 simple commands"
+KUBSH_NO_AST_CACHE=1 run_case "kubsh script (no cache)" "$KUBSH" straight.ksh
+"$KUBSH" straight.ksh > /dev/null 2>&1
+run_case "kubsh script (cached)" "$KUBSH" straight.ksh
+# Интерактивный режим при каждом запуске монтирует VFS и ждёт sleep(1),
+# режим скрипта — нет. Разницу пустых запусков вычитаем из строки stdin
+t0=$(now_ns)
+for _ in 1 2 3; do "$KUBSH" < /dev/null > /dev/null 2>&1; done
+t1=$(now_ns)
+for _ in 1 2 3; do "$KUBSH" -c : > /dev/null 2>&1; done
+t2=$(now_ns)
+extra_us=$(( ((t1 - t0) - (t2 - t1)) / 3000 ))
+STDIN=straight.ksh SUBTRACT_US=$extra_us run_case "kubsh < script (stdin)" "$KUBSH"
+echo "  (stdin row: ${extra_us} us of VFS mount/startup subtracted)"
+run_case "/bin/sh" /bin/sh straight.ksh
+
+# 2. Большой cron-скрипт: много функций, выполняется малая часть
+: > large.ksh
+i=0
+while [ $i -lt 1000 ]; do
+    cat >> large.ksh <<LINES
+handler_$i() {
+    if [ "\$1" = start ] && [ -d /tmp ]; then
+        for f in a b c; do basename "/var/run/\$f.pid" .pid; done
+    elif [ "\$1" = stop ]; then
+        while false; do true; done
+    else
+        printf %s\\\\n "unknown action \$1"
+    fi
+}
+LINES
+    i=$((i + 1))
+done
+echo 'handler_1 start' >> large.ksh
+
+echo "large: $(wc -l < large.ksh) lines, one function called"
+KUBSH_NO_AST_CACHE=1 run_case "kubsh script (no cache)" "$KUBSH" large.ksh
+"$KUBSH" large.ksh > /dev/null 2>&1
+run_case "kubsh script (cached)" "$KUBSH" large.ksh
+run_case "/bin/sh" /bin/sh large.ksh
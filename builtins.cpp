@@ -0,0 +1,1071 @@
+#include "builtins.h"
+
+#include <iostream>
+#include <sstream>
+#include <string_view>
+#include <initializer_list>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <cctype>
+#include <cstdarg>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+
+typedef int (*builtin_fn)(const std::vector<std::string> &tokens,
+                          const std::string &command);
+
+// Утилита не поддерживает опцию/конверсию: ничего не выведено,
+// команда уходит во внешнюю программу из PATH
+static constexpr int BUILTIN_NOT_HANDLED = -1;
+
+// =========================
+// Вспомогательные функции
+// =========================
+
+static bool write_all(int fd, const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        buf += n;
+        len -= n;
+    }
+    return true;
+}
+
+// Копирует in -> out. Для обычных файлов сначала пробуем copy_file_range,
+// затем sendfile, и только потом обычный цикл read/write.
+static bool copy_fd(int in, int out) {
+    struct stat st;
+    if (fstat(in, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        for (;;) {
+            ssize_t n = copy_file_range(in, NULL, out, NULL, 1 << 30, 0);
+            if (n > 0) continue;
+            if (n == 0) return true;
+            if (errno == EINTR) continue;
+            break;
+        }
+        for (;;) {
+            ssize_t n = sendfile(out, in, NULL, 1 << 30);
+            if (n > 0) continue;
+            if (n == 0) return true;
+            if (errno == EINTR) continue;
+            break;
+        }
+    }
+
+    char buf[65536];
+    for (;;) {
+        ssize_t n = read(in, buf, sizeof(buf));
+        if (n == 0) return true;
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        if (!write_all(out, buf, n)) return false;
+    }
+}
+
+static bool parse_int(const std::string &s, long long *out) {
+    if (s.empty()) return false;
+    char *end = NULL;
+    errno = 0;
+    long long v = strtoll(s.c_str(), &end, 10);
+    if (errno != 0 || *end != '\0') return false;
+    *out = v;
+    return true;
+}
+
+// Аргумент printf: основание 0 (0x10, 010), 'A и "A — код символа.
+// При ошибке в *out остаётся разобранное начало, как у coreutils
+static bool parse_printf_int(const std::string &s, long long *out) {
+    if (!s.empty() && (s[0] == '\'' || s[0] == '"')) {
+        *out = s.size() > 1 ? (unsigned char)s[1] : 0;
+        return true;
+    }
+    char *end = NULL;
+    errno = 0;
+    long long v = strtoll(s.c_str(), &end, 0);
+    if (errno == ERANGE && s[0] != '-') {
+        errno = 0;
+        v = (long long)strtoull(s.c_str(), &end, 0);
+    }
+    *out = v;
+    return errno == 0 && end != s.c_str() && *end == '\0';
+}
+
+// snprintf в конец out; буфер расширяется по возвращаемой длине
+static void append_format(std::string &out, const char *fmt, ...) {
+    va_list ap, ap2;
+    va_start(ap, fmt);
+    va_copy(ap2, ap);
+
+    char buf[256];
+    int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    if (n >= 0 && (size_t)n < sizeof(buf)) {
+        out.append(buf, n);
+    } else if (n >= 0) {
+        size_t old = out.size();
+        out.resize(old + n + 1);
+        vsnprintf(&out[old], n + 1, fmt, ap2);
+        out.resize(old + n);
+    }
+    va_end(ap2);
+}
+
+// Опции в стиле getopt_long с перестановкой: shorts — короткие опции,
+// ':' после буквы — опция с аргументом, '+' в начале — опции только до
+// первого операнда; длинные опции только полным именем.
+// Незнакомая опция — false: утилита уходит во внешнюю программу
+struct LongOption {
+    const char *name;
+    char short_name;
+    bool has_arg;
+};
+
+static bool parse_options(const std::vector<std::string> &tokens, const char *shorts,
+                          std::initializer_list<LongOption> longs,
+                          std::vector<std::pair<char, std::string>> &opts,
+                          std::vector<std::string> &operands) {
+    bool in_order = shorts[0] == '+';
+    if (in_order) shorts++;
+    for (size_t i = 1; i < tokens.size(); i++) {
+        const std::string &t = tokens[i];
+        if (t == "--") {
+            operands.insert(operands.end(), tokens.begin() + i + 1, tokens.end());
+            return true;
+        }
+        if (t.size() < 2 || t[0] != '-') {
+            if (in_order) {
+                operands.insert(operands.end(), tokens.begin() + i, tokens.end());
+                return true;
+            }
+            operands.push_back(t);
+            continue;
+        }
+
+        if (t[1] == '-') {
+            size_t eq = t.find('=');
+            std::string name = t.substr(2, eq == std::string::npos ? std::string::npos : eq - 2);
+            const LongOption *opt = NULL;
+            for (auto &l : longs)
+                if (name == l.name) opt = &l;
+            if (!opt || (eq != std::string::npos && !opt->has_arg)) return false;
+            if (!opt->has_arg) {
+                opts.emplace_back(opt->short_name, "");
+            } else if (eq != std::string::npos) {
+                opts.emplace_back(opt->short_name, t.substr(eq + 1));
+            } else {
+                if (++i >= tokens.size()) return false;
+                opts.emplace_back(opt->short_name, tokens[i]);
+            }
+            continue;
+        }
+
+        for (size_t j = 1; j < t.size(); j++) {
+            const char *p = t[j] == ':' ? NULL : strchr(shorts, t[j]);
+            if (!p) return false;
+            if (p[1] != ':') {
+                opts.emplace_back(t[j], "");
+                continue;
+            }
+            if (j + 1 < t.size()) {
+                opts.emplace_back(t[j], t.substr(j + 1));
+            } else {
+                if (++i >= tokens.size()) return false;
+                opts.emplace_back(t[j], tokens[i]);
+            }
+            break;
+        }
+    }
+    return true;
+}
+
+static void partitions_list_devices(FILE *fp) {
+    char line[256];
+    for (int i = 0; i < 2 && fgets(line, sizeof(line), fp); i++);
+    while (fgets(line, sizeof(line), fp)) {
+        char name[64];
+        unsigned int major, minor, blocks;
+        if (sscanf(line, "%u %u %u %63s", &major, &minor, &blocks, name) == 4) {
+            std::cout << "  /dev/" << name << '\n';
+        }
+    }
+}
+
+// =========================
+// Встроенные команды shell
+// =========================
+
+static int builtin_debug(const std::vector<std::string> &tokens,
+                         const std::string &command) {
+    if (tokens.size() > 1) {
+        std::string out = command.substr(6);
+        if (out.front() == '\'' && out.back() == '\'')
+            out = out.substr(1, out.size() - 2);
+        std::cout << out << '\n';
+    }
+    return 0;
+}
+
+static int builtin_echo(const std::vector<std::string> &,
+                        const std::string &command) {
+    std::cout << (command.size() > 5 ? command.substr(5) : "") << '\n';
+    return 0;
+}
+
+static int builtin_env_list(const std::vector<std::string> &tokens,
+                            const std::string &) {
+    if (tokens.size() != 2) return 1;
+    char *v = getenv(tokens[1].substr(1).c_str());
+    if (v) {
+        std::stringstream ss(v);
+        std::string p;
+        while (std::getline(ss, p, ':'))
+            std::cout << p << '\n';
+    }
+    return 0;
+}
+
+static int builtin_cd(const std::vector<std::string> &tokens,
+                      const std::string &) {
+    return chdir(tokens.size() > 1 ? tokens[1].c_str() : getenv("HOME")) == 0 ? 0 : 1;
+}
+
+// \l - list disk partitions
+static int builtin_list_partitions(const std::vector<std::string> &tokens,
+                                   const std::string &) {
+    if (tokens.size() != 2) {
+        std::cout << "Usage: \\l /dev/sda" << '\n';
+        std::cout << "\nAvailable block devices from /proc/partitions:" << '\n';
+
+        FILE *fp = fopen("/proc/partitions", "r");
+        if (fp) {
+            partitions_list_devices(fp);
+            fclose(fp);
+        }
+        return 0;
+    }
+
+    std::string device = tokens[1];
+
+    // Проверяем, существует ли устройство
+    struct stat st;
+    if (stat(device.c_str(), &st) == 0) {
+        // Устройство существует, используем fdisk
+        std::string command = "fdisk -l " + device + " 2>/dev/null";
+
+        FILE *pipe = popen(command.c_str(), "r");
+        if (!pipe) {
+            std::cout << "Failed to execute fdisk" << '\n';
+            return 1;
+        }
+
+        char buffer[256];
+        bool found = false;
+        std::cout << "Partition table for " << device << ":" << '\n';
+        while (fgets(buffer, sizeof(buffer), pipe) != NULL) {
+            found = true;
+            std::cout << buffer;
+        }
+
+        pclose(pipe);
+
+        if (!found) {
+            std::cout << "No partition table or unable to read" << '\n';
+        }
+        return 0;
+    }
+
+    // Попробуем найти устройство в /proc/partitions
+    FILE *fp = fopen("/proc/partitions", "r");
+    if (!fp) {
+        std::cout << device << ": no such device (cannot access /proc/partitions)" << '\n';
+        return 1;
+    }
+
+    char line[256];
+    bool device_found = false;
+    bool partitions_found = false;
+
+    // Извлекаем имя устройства из пути
+    std::string dev_name = device;
+    size_t pos = dev_name.find_last_of('/');
+    if (pos != std::string::npos) {
+        dev_name = dev_name.substr(pos + 1);
+    }
+
+    std::cout << "Looking for device: " << dev_name << '\n';
+
+    // Пропускаем заголовок
+    for (int i = 0; i < 2 && fgets(line, sizeof(line), fp); i++);
+
+    while (fgets(line, sizeof(line), fp)) {
+        char name[64];
+        unsigned int major, minor, blocks;
+
+        if (sscanf(line, "%u %u %u %63s", &major, &minor, &blocks, name) == 4) {
+            std::string part_name(name);
+
+            // Ищем само устройство
+            if (part_name == dev_name) {
+                device_found = true;
+                std::cout << "Device found in /proc/partitions:" << '\n';
+                std::cout << "  " << device << " (major: " << major
+                          << ", minor: " << minor
+                          << ", blocks: " << blocks << ")" << '\n';
+            }
+
+            // Ищем разделы этого устройства
+            if (part_name.find(dev_name) == 0 && part_name.length() > dev_name.length()) {
+                partitions_found = true;
+                std::cout << "  Partition: /dev/" << part_name
+                          << " (" << blocks << " blocks)" << '\n';
+            }
+        }
+    }
+
+    fclose(fp);
+
+    if (!device_found) {
+        std::cout << device << ": no such device in /proc/partitions" << '\n';
+
+        // Покажем все доступные устройства
+        std::cout << "\nAvailable block devices:" << '\n';
+        fp = fopen("/proc/partitions", "r");
+        if (fp) {
+            partitions_list_devices(fp);
+            fclose(fp);
+        }
+    } else if (!partitions_found) {
+        std::cout << "No partitions found for this device" << '\n';
+    }
+    return 0;
+}
+
+// =========================
+// Быстрые утилиты (без fork)
+// =========================
+
+// --help и --version печатает только внешняя программа
+static bool is_help_or_version(const std::vector<std::string> &tokens) {
+    return tokens.size() == 2 && (tokens[1] == "--help" || tokens[1] == "--version");
+}
+
+static int builtin_true(const std::vector<std::string> &tokens, const std::string &) {
+    return is_help_or_version(tokens) ? BUILTIN_NOT_HANDLED : 0;
+}
+
+static int builtin_false(const std::vector<std::string> &tokens, const std::string &) {
+    return is_help_or_version(tokens) ? BUILTIN_NOT_HANDLED : 1;
+}
+
+static int builtin_cat(const std::vector<std::string> &tokens,
+                       const std::string &) {
+    // Сами копируем только без опций форматирования (-u ничего не меняет)
+    std::vector<std::pair<char, std::string>> opts;
+    std::vector<std::string> files;
+    if (!parse_options(tokens, "u", {}, opts, files)) return BUILTIN_NOT_HANDLED;
+    if (files.empty()) files.push_back("-");
+
+    // Данные идут мимо буфера std::cout, поэтому сначала сбрасываем его
+    std::cout.flush();
+
+    int status = 0;
+    for (auto &f : files) {
+        if (f == "-") {
+            if (!copy_fd(STDIN_FILENO, STDOUT_FILENO)) status = 1;
+            continue;
+        }
+
+        int fd = open(f.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            std::cerr << "cat: " << f << ": " << strerror(errno) << '\n';
+            status = 1;
+            continue;
+        }
+        if (!copy_fd(fd, STDOUT_FILENO)) {
+            std::cerr << "cat: " << f << ": " << strerror(errno) << '\n';
+            status = 1;
+        }
+        close(fd);
+    }
+    return status;
+}
+
+// Разбор выражения test / [ методом рекурсивного спуска:
+//   expr := and ("-o" and)*
+//   and  := not ("-a" not)*
+//   not  := "!" not | primary
+//   primary := "(" expr ")" | arg binop arg | unop arg | arg
+struct TestParser {
+    const std::vector<std::string> &args;
+    size_t pos;
+    size_t end;
+    bool error;
+
+    bool at(const char *s) const { return pos < end && args[pos] == s; }
+
+    static bool is_binary(const std::string &op) {
+        return op == "=" || op == "==" || op == "!=" ||
+               op == "-eq" || op == "-ne" || op == "-lt" ||
+               op == "-le" || op == "-gt" || op == "-ge" ||
+               op == "-nt" || op == "-ot" || op == "-ef";
+    }
+
+    static bool is_unary(const std::string &op) {
+        return op.size() == 2 && op[0] == '-' &&
+               strchr("bcdefghLnprsStwxz", op[1]) != NULL;
+    }
+
+    bool fail(const std::string &msg) {
+        if (!error) std::cerr << "test: " << msg << '\n';
+        error = true;
+        return false;
+    }
+
+    bool expr() {
+        bool v = and_expr();
+        while (!error && at("-o")) {
+            pos++;
+            bool rhs = and_expr();
+            v = v || rhs;
+        }
+        return v;
+    }
+
+    bool and_expr() {
+        bool v = not_expr();
+        while (!error && at("-a")) {
+            pos++;
+            bool rhs = not_expr();
+            v = v && rhs;
+        }
+        return v;
+    }
+
+    bool not_expr() {
+        if (at("!") && pos + 1 < end) {
+            pos++;
+            return !not_expr();
+        }
+        return primary();
+    }
+
+    bool primary() {
+        if (pos >= end) return fail("argument expected");
+
+        if (pos + 2 < end && is_binary(args[pos + 1])) {
+            const std::string &a = args[pos];
+            const std::string &op = args[pos + 1];
+            const std::string &b = args[pos + 2];
+            pos += 3;
+            return binary(a, op, b);
+        }
+
+        if (at("(") && pos + 1 < end) {
+            pos++;
+            bool v = expr();
+            if (!at(")")) return fail("')' expected");
+            pos++;
+            return v;
+        }
+
+        if (pos + 1 < end && is_unary(args[pos])) {
+            const std::string &op = args[pos];
+            const std::string &a = args[pos + 1];
+            pos += 2;
+            return unary(op[1], a);
+        }
+
+        return !args[pos++].empty();
+    }
+
+    bool unary(char op, const std::string &a) {
+        if (op == 'n') return !a.empty();
+        if (op == 'z') return a.empty();
+        if (op == 't') {
+            long long fd;
+            if (!parse_int(a, &fd)) return fail("integer expression expected: " + a);
+            return isatty((int)fd);
+        }
+
+        struct stat st;
+        if (op == 'h' || op == 'L')
+            return lstat(a.c_str(), &st) == 0 && S_ISLNK(st.st_mode);
+        if (op == 'r') return access(a.c_str(), R_OK) == 0;
+        if (op == 'w') return access(a.c_str(), W_OK) == 0;
+        if (op == 'x') return access(a.c_str(), X_OK) == 0;
+        if (stat(a.c_str(), &st) != 0) return false;
+
+        switch (op) {
+            case 'e': return true;
+            case 'f': return S_ISREG(st.st_mode);
+            case 'd': return S_ISDIR(st.st_mode);
+            case 'b': return S_ISBLK(st.st_mode);
+            case 'c': return S_ISCHR(st.st_mode);
+            case 'p': return S_ISFIFO(st.st_mode);
+            case 'S': return S_ISSOCK(st.st_mode);
+            case 's': return st.st_size > 0;
+            case 'g': return (st.st_mode & S_ISGID) != 0;
+            case 'u': return (st.st_mode & S_ISUID) != 0;
+        }
+        return false;
+    }
+
+    bool binary(const std::string &a, const std::string &op, const std::string &b) {
+        if (op == "=" || op == "==") return a == b;
+        if (op == "!=") return a != b;
+
+        if (op == "-nt" || op == "-ot" || op == "-ef") {
+            struct stat sa, sb;
+            bool ha = stat(a.c_str(), &sa) == 0;
+            bool hb = stat(b.c_str(), &sb) == 0;
+            if (op == "-ef")
+                return ha && hb && sa.st_dev == sb.st_dev && sa.st_ino == sb.st_ino;
+            if (op == "-nt")
+                return ha && (!hb || sa.st_mtim.tv_sec > sb.st_mtim.tv_sec ||
+                              (sa.st_mtim.tv_sec == sb.st_mtim.tv_sec &&
+                               sa.st_mtim.tv_nsec > sb.st_mtim.tv_nsec));
+            return hb && (!ha || sa.st_mtim.tv_sec < sb.st_mtim.tv_sec ||
+                          (sa.st_mtim.tv_sec == sb.st_mtim.tv_sec &&
+                           sa.st_mtim.tv_nsec < sb.st_mtim.tv_nsec));
+        }
+
+        long long x, y;
+        if (!parse_int(a, &x)) return fail("integer expression expected: " + a);
+        if (!parse_int(b, &y)) return fail("integer expression expected: " + b);
+        if (op == "-eq") return x == y;
+        if (op == "-ne") return x != y;
+        if (op == "-lt") return x < y;
+        if (op == "-le") return x <= y;
+        if (op == "-gt") return x > y;
+        return x >= y;
+    }
+};
+
+static int builtin_test(const std::vector<std::string> &tokens,
+                        const std::string &) {
+    size_t end = tokens.size();
+    if (tokens[0] == "[") {
+        if (tokens.back() != "]" || end < 2) {
+            std::cerr << "[: missing ']'" << '\n';
+            return 2;
+        }
+        end--;
+    }
+
+    // Без аргументов — ложь
+    if (end == 1) return 1;
+
+    TestParser p{tokens, 1, end, false};
+    bool v = p.expr();
+    if (!p.error && p.pos != end) p.fail("extra argument '" + tokens[p.pos] + "'");
+    if (p.error) return 2;
+    return v ? 0 : 1;
+}
+
+enum EscapeResult { ESCAPE_OK, ESCAPE_STOP, ESCAPE_UNSUPPORTED };
+
+// Обрабатывает escape-последовательность в s[i] (s[i] == '\\').
+// Возвращает индекс последнего обработанного символа. in_arg — аргумент %b:
+// там восьмеричный код пишется как \0NNN. \c прекращает весь вывод
+static size_t printf_escape(const std::string &s, size_t i, std::string &out,
+                            bool in_arg, EscapeResult *res) {
+    *res = ESCAPE_OK;
+    if (i + 1 >= s.size()) {
+        out += '\\';
+        return i;
+    }
+    char c = s[++i];
+    switch (c) {
+        case 'n': out += '\n'; break;
+        case 't': out += '\t'; break;
+        case 'r': out += '\r'; break;
+        case 'a': out += '\a'; break;
+        case 'b': out += '\b'; break;
+        case 'e': out += '\033'; break;
+        case 'f': out += '\f'; break;
+        case 'v': out += '\v'; break;
+        case '\\': out += '\\'; break;
+        case '"': out += '"'; break;
+        case '\'': out += '\''; break;
+        case 'c': *res = ESCAPE_STOP; break;
+        case 'x': {
+            int v = 0, n = 0;
+            while (n < 2 && i + 1 < s.size() && isxdigit((unsigned char)s[i + 1])) {
+                char h = s[++i];
+                v = v * 16 + (isdigit((unsigned char)h) ? h - '0' : (tolower(h) - 'a' + 10));
+                n++;
+            }
+            if (n == 0) *res = ESCAPE_UNSUPPORTED;
+            out += (char)v;
+            break;
+        }
+        case '0': case '1': case '2': case '3':
+        case '4': case '5': case '6': case '7': {
+            if (in_arg && c == '0') i++;
+            int v = 0, n = 0;
+            while (n < 3 && i < s.size() && s[i] >= '0' && s[i] <= '7') {
+                v = v * 8 + (s[i] - '0');
+                i++;
+                n++;
+            }
+            out += (char)v;
+            return i - 1;
+        }
+        // \u, \U зависят от локали — оставляем внешнему printf
+        case 'u': case 'U':
+            *res = ESCAPE_UNSUPPORTED;
+            break;
+        default:
+            out += '\\';
+            out += c;
+    }
+    return i;
+}
+
+// Числовой аргумент printf; сообщение об ошибке копится в errors
+static long long printf_int_arg(const std::string &value, std::string &errors) {
+    long long v = 0;
+    if (!value.empty() && !parse_printf_int(value, &v))
+        errors += "printf: '" + value + "': expected a numeric value\n";
+    return v;
+}
+
+static int builtin_printf(const std::vector<std::string> &tokens,
+                          const std::string &) {
+    if (is_help_or_version(tokens)) return BUILTIN_NOT_HANDLED;
+
+    size_t first = tokens.size() > 1 && tokens[1] == "--" ? 2 : 1;
+    // Ошибки использования (с подсказкой --help) печатает внешний printf
+    if (tokens.size() <= first) return BUILTIN_NOT_HANDLED;
+
+    // Вывод и ошибки копятся до конца: при неподдерживаемой конверсии
+    // команда целиком уходит во внешний printf
+    const std::string &fmt = tokens[first];
+    size_t arg = first + 1;
+    int status = 0;
+    std::string out, errors;
+    bool stop = false;
+    EscapeResult esc;
+
+    auto next_arg = [&]() -> std::string {
+        return arg < tokens.size() ? tokens[arg++] : "";
+    };
+
+    // Формат повторяется, пока не закончатся аргументы
+    do {
+        size_t first_arg = arg;
+        for (size_t i = 0; i < fmt.size() && !stop; i++) {
+            char c = fmt[i];
+            if (c == '\\') {
+                i = printf_escape(fmt, i, out, false, &esc);
+                if (esc == ESCAPE_UNSUPPORTED) return BUILTIN_NOT_HANDLED;
+                if (esc == ESCAPE_STOP) stop = true;
+                continue;
+            }
+            if (c != '%') {
+                out += c;
+                continue;
+            }
+            if (i + 1 < fmt.size() && fmt[i + 1] == '%') {
+                out += '%';
+                i++;
+                continue;
+            }
+
+            // %[флаги][ширина][.точность][длина]спецификатор;
+            // * берёт ширину/точность из аргумента, длина (l, h, ...) игнорируется
+            size_t start = i++;
+            std::string spec = "%";
+            while (i < fmt.size() && strchr("-+ #0", fmt[i])) spec += fmt[i++];
+            if (i < fmt.size() && fmt[i] == '*') {
+                spec += std::to_string(printf_int_arg(next_arg(), errors));
+                i++;
+            } else {
+                while (i < fmt.size() && isdigit((unsigned char)fmt[i])) spec += fmt[i++];
+            }
+            if (i < fmt.size() && fmt[i] == '.') {
+                spec += fmt[i++];
+                if (i < fmt.size() && fmt[i] == '*') {
+                    // Отрицательная точность — как если бы её не было
+                    long long prec = printf_int_arg(next_arg(), errors);
+                    if (prec < 0) spec.pop_back();
+                    else spec += std::to_string(prec);
+                    i++;
+                } else {
+                    while (i < fmt.size() && isdigit((unsigned char)fmt[i])) spec += fmt[i++];
+                }
+            }
+            while (i < fmt.size() && strchr("hlLqjzt", fmt[i])) i++;
+            if (i >= fmt.size()) {
+                out += fmt.substr(start);
+                break;
+            }
+
+            char conv = fmt[i];
+            if (!strchr("sbcdiouxXeEfFgG", conv)) return BUILTIN_NOT_HANDLED;
+            const std::string value = next_arg();
+
+            switch (conv) {
+                case 's':
+                    append_format(out, (spec + "s").c_str(), value.c_str());
+                    break;
+                case 'b': {
+                    std::string expanded;
+                    for (size_t j = 0; j < value.size() && !stop; j++) {
+                        if (value[j] != '\\') {
+                            expanded += value[j];
+                            continue;
+                        }
+                        j = printf_escape(value, j, expanded, true, &esc);
+                        if (esc == ESCAPE_UNSUPPORTED) return BUILTIN_NOT_HANDLED;
+                        if (esc == ESCAPE_STOP) stop = true;
+                    }
+                    append_format(out, (spec + "s").c_str(), expanded.c_str());
+                    break;
+                }
+                case 'c':
+                    append_format(out, (spec + "c").c_str(), value.empty() ? 0 : value[0]);
+                    break;
+                case 'd': case 'i': case 'u': case 'o': case 'x': case 'X':
+                    append_format(out, (spec + "ll" + conv).c_str(), printf_int_arg(value, errors));
+                    break;
+                default: {
+                    char *end = NULL;
+                    double v = 0.0;
+                    if (!value.empty() && (value[0] == '\'' || value[0] == '"'))
+                        v = value.size() > 1 ? (unsigned char)value[1] : 0;
+                    else if (!value.empty())
+                        v = strtod(value.c_str(), &end);
+                    if (end && (end == value.c_str() || *end != '\0'))
+                        errors += "printf: '" + value + "': expected a numeric value\n";
+                    append_format(out, (spec + conv).c_str(), v);
+                    break;
+                }
+            }
+        }
+        if (arg == first_arg || stop) break;
+    } while (arg < tokens.size());
+
+    if (!errors.empty()) {
+        std::cerr << errors;
+        status = 1;
+    }
+    std::cout << out;
+    return status;
+}
+
+static int builtin_basename(const std::vector<std::string> &tokens,
+                            const std::string &) {
+    std::vector<std::pair<char, std::string>> opts;
+    std::vector<std::string> ops;
+    if (!parse_options(tokens, "+as:z",
+                       {{"multiple", 'a', false}, {"suffix", 's', true}, {"zero", 'z', false}},
+                       opts, ops))
+        return BUILTIN_NOT_HANDLED;
+
+    bool multiple = false;
+    char end = '\n';
+    std::string suffix;
+    for (auto &o : opts) {
+        if (o.first == 'a') multiple = true;
+        if (o.first == 'z') end = '\0';
+        if (o.first == 's') {
+            suffix = o.second;
+            multiple = true;
+        }
+    }
+
+    // Ошибки использования (с подсказкой --help) печатает внешний basename
+    if (ops.empty() || (!multiple && ops.size() > 2)) return BUILTIN_NOT_HANDLED;
+    if (!multiple) {
+        if (ops.size() == 2) suffix = ops[1];
+        ops.resize(1);
+    }
+
+    for (auto &op : ops) {
+        std::string name = op;
+        size_t last = name.find_last_not_of('/');
+        if (last == std::string::npos) {
+            std::cout << (name.empty() ? "" : "/") << end;
+            continue;
+        }
+        name.erase(last + 1);
+        size_t slash = name.find_last_of('/');
+        if (slash != std::string::npos) name.erase(0, slash + 1);
+
+        if (!suffix.empty() && name.size() > suffix.size() &&
+            name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0)
+            name.erase(name.size() - suffix.size());
+
+        std::cout << name << end;
+    }
+    return 0;
+}
+
+static int builtin_dirname(const std::vector<std::string> &tokens,
+                           const std::string &) {
+    std::vector<std::pair<char, std::string>> opts;
+    std::vector<std::string> ops;
+    if (!parse_options(tokens, "z", {{"zero", 'z', false}}, opts, ops))
+        return BUILTIN_NOT_HANDLED;
+    char end = opts.empty() ? '\n' : '\0';
+    if (ops.empty()) return BUILTIN_NOT_HANDLED;
+
+    for (auto &name : ops) {
+        size_t last = name.find_last_not_of('/');
+        if (last == std::string::npos) {
+            std::cout << (name.empty() ? "." : "/") << end;
+            continue;
+        }
+        size_t slash = name.find_last_of('/', last);
+        if (slash == std::string::npos) {
+            std::cout << "." << end;
+            continue;
+        }
+        size_t dir_end = name.find_last_not_of('/', slash);
+        if (dir_end == std::string::npos) {
+            std::cout << "/" << end;
+            continue;
+        }
+        std::cout << name.substr(0, dir_end + 1) << end;
+    }
+    return 0;
+}
+
+struct WcCounts {
+    unsigned long long lines = 0;
+    unsigned long long words = 0;
+    unsigned long long bytes = 0;
+};
+
+static bool wc_count(int fd, WcCounts *c) {
+    char buf[65536];
+    bool in_word = false;
+    for (;;) {
+        ssize_t n = read(fd, buf, sizeof(buf));
+        if (n == 0) return true;
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        c->bytes += n;
+        for (ssize_t i = 0; i < n; i++) {
+            unsigned char ch = buf[i];
+            if (ch == '\n') c->lines++;
+            if (isspace(ch)) {
+                in_word = false;
+            } else if (!in_word) {
+                in_word = true;
+                c->words++;
+            }
+        }
+    }
+}
+
+static int builtin_wc(const std::vector<std::string> &tokens,
+                      const std::string &) {
+    // -m и -L зависят от локали — их считает внешний wc
+    std::vector<std::pair<char, std::string>> opts;
+    std::vector<std::string> files;
+    if (!parse_options(tokens, "lwc",
+                       {{"lines", 'l', false}, {"words", 'w', false}, {"bytes", 'c', false}},
+                       opts, files))
+        return BUILTIN_NOT_HANDLED;
+
+    bool show_lines = false, show_words = false, show_bytes = false;
+    for (auto &o : opts) {
+        if (o.first == 'l') show_lines = true;
+        if (o.first == 'w') show_words = true;
+        if (o.first == 'c') show_bytes = true;
+    }
+    if (!show_lines && !show_words && !show_bytes)
+        show_lines = show_words = show_bytes = true;
+
+    // Ширина колонок как у GNU wc: по суммарному размеру обычных файлов,
+    // минимум 7 для каналов и прочих потоков, 1 — если выводится одно число
+    int fields = show_lines + show_words + show_bytes;
+    int width = 1;
+    if (!(fields == 1 && files.size() <= 1)) {
+        unsigned long long total_size = 0;
+        int min_width = 1;
+        const std::vector<std::string> stdin_only{"-"};
+        for (auto &f : files.empty() ? stdin_only : files) {
+            struct stat st;
+            int r = f == "-" ? fstat(STDIN_FILENO, &st) : stat(f.c_str(), &st);
+            if (r == 0 && S_ISREG(st.st_mode))
+                total_size += st.st_size;
+            else
+                min_width = 7;
+        }
+        for (; total_size >= 10; total_size /= 10) width++;
+        if (width < min_width) width = min_width;
+    }
+
+    auto print = [&](const WcCounts &c, const std::string &name) {
+        const char *sep = "";
+        char buf[32];
+        if (show_lines) {
+            snprintf(buf, sizeof(buf), "%s%*llu", sep, width, c.lines);
+            std::cout << buf;
+            sep = " ";
+        }
+        if (show_words) {
+            snprintf(buf, sizeof(buf), "%s%*llu", sep, width, c.words);
+            std::cout << buf;
+            sep = " ";
+        }
+        if (show_bytes) {
+            snprintf(buf, sizeof(buf), "%s%*llu", sep, width, c.bytes);
+            std::cout << buf;
+        }
+        if (!name.empty()) std::cout << ' ' << name;
+        std::cout << '\n';
+    };
+
+    if (files.empty()) {
+        WcCounts c;
+        if (!wc_count(STDIN_FILENO, &c)) {
+            std::cerr << "wc: -: " << strerror(errno) << '\n';
+            return 1;
+        }
+        print(c, "");
+        return 0;
+    }
+
+    int status = 0;
+    WcCounts total;
+    for (auto &f : files) {
+        WcCounts c;
+        int fd = f == "-" ? STDIN_FILENO : open(f.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            std::cerr << "wc: " << f << ": " << strerror(errno) << '\n';
+            status = 1;
+            continue;
+        }
+        bool ok = wc_count(fd, &c);
+        if (fd != STDIN_FILENO) close(fd);
+        if (!ok) {
+            std::cerr << "wc: " << f << ": " << strerror(errno) << '\n';
+            status = 1;
+            continue;
+        }
+        print(c, f);
+        total.lines += c.lines;
+        total.words += c.words;
+        total.bytes += c.bytes;
+    }
+    if (files.size() > 1) print(total, "total");
+    return status;
+}
+
+// =========================
+// Реестр встроенных команд
+// =========================
+
+struct Builtin {
+    std::string_view name;
+    builtin_fn fn;
+    // Есть аналог в PATH: при KUBSH_NO_BUILTINS=1 команда уходит в fork/execve
+    bool has_external;
+};
+
+static constexpr Builtin builtins[] = {
+    {"debug",    builtin_debug,           false},
+    {"echo",     builtin_echo,            false},
+    {"\\e",      builtin_env_list,        false},
+    {"cd",       builtin_cd,              false},
+    {"\\l",      builtin_list_partitions, false},
+    {"cat",      builtin_cat,             true},
+    {"test",     builtin_test,            true},
+    {"[",        builtin_test,            true},
+    {"printf",   builtin_printf,          true},
+    {"basename", builtin_basename,        true},
+    {"dirname",  builtin_dirname,         true},
+    {"true",     builtin_true,            true},
+    {"false",    builtin_false,           true},
+    {"wc",       builtin_wc,              true},
+};
+
+static constexpr size_t builtin_count = sizeof(builtins) / sizeof(builtins[0]);
+static constexpr size_t table_size = 32;
+static_assert((table_size & (table_size - 1)) == 0, "table_size must be a power of two");
+static_assert(builtin_count <= table_size, "table_size too small");
+
+// FNV-1a с затравкой; затравка подбирается при компиляции так,
+// чтобы все имена попали в разные ячейки (идеальное хеширование)
+static constexpr uint32_t name_hash(std::string_view s, uint32_t seed) {
+    uint32_t h = 2166136261u ^ seed;
+    for (char c : s) {
+        h ^= (unsigned char)c;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static constexpr uint32_t find_seed() {
+    for (uint32_t seed = 0; seed < 100000; seed++) {
+        bool used[table_size] = {};
+        bool ok = true;
+        for (size_t i = 0; i < builtin_count && ok; i++) {
+            size_t slot = name_hash(builtins[i].name, seed) & (table_size - 1);
+            if (used[slot]) ok = false;
+            used[slot] = true;
+        }
+        if (ok) return seed;
+    }
+    return UINT32_MAX;
+}
+
+static constexpr uint32_t hash_seed = find_seed();
+static_assert(hash_seed != UINT32_MAX, "no perfect hash seed for builtins");
+
+struct BuiltinTable {
+    int8_t slot[table_size];
+};
+
+static constexpr BuiltinTable make_table() {
+    BuiltinTable t{};
+    for (size_t i = 0; i < table_size; i++) t.slot[i] = -1;
+    for (size_t i = 0; i < builtin_count; i++)
+        t.slot[name_hash(builtins[i].name, hash_seed) & (table_size - 1)] = (int8_t)i;
+    return t;
+}
+
+static constexpr BuiltinTable builtin_table = make_table();
+
+static const Builtin *find_builtin(std::string_view name) {
+    int idx = builtin_table.slot[name_hash(name, hash_seed) & (table_size - 1)];
+    if (idx < 0 || builtins[idx].name != name) return NULL;
+    return &builtins[idx];
+}
+
+bool run_builtin(const std::vector<std::string> &tokens,
+                 const std::string &command, int *status) {
+    // KUBSH_NO_BUILTINS= и KUBSH_NO_BUILTINS=0 не отключают встроенные утилиты
+    static const bool no_external_builtins = [] {
+        const char *v = getenv("KUBSH_NO_BUILTINS");
+        return v && *v && strcmp(v, "0") != 0;
+    }();
+
+    const Builtin *b = find_builtin(tokens[0]);
+    if (!b) return false;
+    if (b->has_external && no_external_builtins) return false;
+
+    int ret = b->fn(tokens, command);
+    if (ret == BUILTIN_NOT_HANDLED) return false;
+    *status = ret;
+    // Один сброс на команду вместо std::endl на каждой строке
+    std::cout.flush();
+    return true;
+}
@@ -0,0 +1,13 @@
+#ifndef BUILTINS_H
+#define BUILTINS_H
+
+#include <string>
+#include <vector>
+
+// Выполняет встроенную команду без fork/execve.
+// Возвращает true, если tokens[0] — встроенная команда; код завершения
+// записывается в *status. command — исходная строка (нужна echo/debug).
+bool run_builtin(const std::vector<std::string> &tokens,
+                 const std::string &command, int *status);
+
+#endif
@@ -0,0 +1,1300 @@
+#include "script.h"
+
+#include <iostream>
+#include <unordered_map>
+#include <unordered_set>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <cctype>
+#include <climits>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// =========================
+// Плоское AST
+// =========================
+//
+// Все узлы лежат в одном массиве и ссылаются друг на друга индексами,
+// строки — смещениями в общем пуле. Такой образ не требует десериализации:
+// интерпретатор работает с ним одинаково после разбора и после mmap кеша.
+// Дочерний узел всегда создаётся раньше родителя (индекс меньше),
+// поэтому при проверке кеша циклы исключены.
+
+enum NodeKind : uint32_t {
+    N_NONE,
+    N_LIST,    // a = начало в refs, b = количество
+    N_CMD,     // a, b = присваивания в refs; c, d = слова в refs
+    N_ASSIGN,  // a, b = имя (смещение, длина); c = слово-значение
+    N_WORD,    // a, b = части слова в refs
+    N_LIT,     // a, b = текст; c = в кавычках
+    N_VAR,     // a, b = имя переменной; c = в кавычках
+    N_AND,     // a && b
+    N_OR,      // a || b
+    N_NOT,     // ! a
+    N_IF,      // if a; then b; else c; fi (c = 0 — нет else)
+    N_WHILE,   // while a; do b; done (c = 1 — until)
+    N_FOR,     // a, b = имя; c = список слов (0 — "$@"); d = тело
+    N_FUNC,    // a, b = имя; c = тело
+};
+
+struct AstNode {
+    uint32_t kind;
+    uint32_t a, b, c, d;
+};
+
+struct ScriptImage {
+    const AstNode *nodes;
+    uint32_t node_count;
+    const uint32_t *refs;
+    uint32_t ref_count;
+    const char *strings;
+    uint32_t string_size;
+    uint32_t root;
+};
+
+struct AstBuilder {
+    std::vector<AstNode> nodes;
+    std::vector<uint32_t> refs;
+    std::string strings;
+
+    AstBuilder() { nodes.push_back(AstNode{N_NONE, 0, 0, 0, 0}); }
+
+    uint32_t add(uint32_t kind, uint32_t a = 0, uint32_t b = 0,
+                 uint32_t c = 0, uint32_t d = 0) {
+        nodes.push_back(AstNode{kind, a, b, c, d});
+        return nodes.size() - 1;
+    }
+
+    uint32_t add_string(const std::string &s) {
+        uint32_t off = strings.size();
+        strings += s;
+        return off;
+    }
+
+    uint32_t add_refs(const std::vector<uint32_t> &items) {
+        uint32_t start = refs.size();
+        refs.insert(refs.end(), items.begin(), items.end());
+        return start;
+    }
+
+    ScriptImage image() const {
+        return ScriptImage{nodes.data(), (uint32_t)nodes.size(),
+                           refs.data(), (uint32_t)refs.size(),
+                           strings.data(), (uint32_t)strings.size(),
+                           (uint32_t)nodes.size() - 1};
+    }
+};
+
+// =========================
+// Лексер
+// =========================
+
+enum TokType { T_WORD, T_NEWLINE, T_SEMI, T_AND, T_OR, T_LPAREN, T_RPAREN, T_EOF };
+
+struct WordPart {
+    bool var;
+    bool quoted;
+    std::string text;
+};
+
+struct Token {
+    TokType type = T_EOF;
+    std::vector<WordPart> parts;
+    bool plain = false;     // только текст без кавычек и $
+    std::string literal;    // текст, если plain
+    int line = 1;
+};
+
+static bool is_name_start(char c) {
+    return c == '_' || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+static bool is_name_char(char c) {
+    return is_name_start(c) || (c >= '0' && c <= '9');
+}
+
+static bool is_valid_name(const std::string &s) {
+    if (s.empty() || !is_name_start(s[0])) return false;
+    for (char c : s)
+        if (!is_name_char(c)) return false;
+    return true;
+}
+
+class Lexer {
+public:
+    explicit Lexer(const std::string &src) : src_(src) {}
+
+    std::string error;
+
+    bool next(Token &tok) {
+        tok = Token();
+        skip_blanks();
+        tok.line = line_;
+
+        if (pos_ >= src_.size()) {
+            tok.type = T_EOF;
+            return true;
+        }
+
+        char c = src_[pos_];
+        if (c == '\n') {
+            pos_++;
+            line_++;
+            tok.type = T_NEWLINE;
+            return true;
+        }
+        if (c == ';') {
+            pos_++;
+            tok.type = T_SEMI;
+            return true;
+        }
+        if (c == '&') {
+            if (peek(1) != '&') return fail("background jobs are not supported");
+            pos_ += 2;
+            tok.type = T_AND;
+            return true;
+        }
+        if (c == '|') {
+            if (peek(1) != '|') return fail("pipes are not supported");
+            pos_ += 2;
+            tok.type = T_OR;
+            return true;
+        }
+        if (c == '(' || c == ')') {
+            pos_++;
+            tok.type = c == '(' ? T_LPAREN : T_RPAREN;
+            return true;
+        }
+        if (c == '<' || c == '>') return fail("redirections are not supported");
+
+        tok.type = T_WORD;
+        return read_word(tok);
+    }
+
+private:
+    const std::string &src_;
+    size_t pos_ = 0;
+    int line_ = 1;
+
+    char peek(size_t off) const {
+        return pos_ + off < src_.size() ? src_[pos_ + off] : '\0';
+    }
+
+    bool fail(const std::string &msg) {
+        error = "line " + std::to_string(line_) + ": " + msg;
+        return false;
+    }
+
+    void skip_blanks() {
+        while (pos_ < src_.size()) {
+            char c = src_[pos_];
+            if (c == ' ' || c == '\t' || c == '\r') {
+                pos_++;
+            } else if (c == '\\' && peek(1) == '\n') {
+                pos_ += 2;
+                line_++;
+            } else if (c == '#') {
+                while (pos_ < src_.size() && src_[pos_] != '\n') pos_++;
+            } else {
+                break;
+            }
+        }
+    }
+
+    static bool is_meta(char c) {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == ';' ||
+               c == '&' || c == '|' || c == '(' || c == ')' || c == '<' || c == '>';
+    }
+
+    static void add_text(Token &tok, bool quoted, const std::string &text) {
+        if (!tok.parts.empty() && !tok.parts.back().var &&
+            tok.parts.back().quoted == quoted) {
+            tok.parts.back().text += text;
+            return;
+        }
+        tok.parts.push_back(WordPart{false, quoted, text});
+    }
+
+    // $name, ${name}, $1, $?, $#, $@, $*, $$
+    bool read_var(Token &tok, bool quoted) {
+        pos_++;
+        char c = peek(0);
+        std::string name;
+        if (c == '{') {
+            size_t end = src_.find('}', pos_);
+            if (end == std::string::npos) return fail("missing '}'");
+            name = src_.substr(pos_ + 1, end - pos_ - 1);
+            pos_ = end + 1;
+            // Только ${name}, ${10}, ${?} и т.п.: ${x:-y}, ${#x} не поддерживаются
+            bool digits = !name.empty() &&
+                          name.find_first_not_of("0123456789") == std::string::npos;
+            bool special = name.size() == 1 && strchr("?#@*$", name[0]);
+            if (!is_valid_name(name) && !digits && !special)
+                return fail("bad substitution");
+        } else if (is_name_start(c)) {
+            while (pos_ < src_.size() && is_name_char(src_[pos_])) name += src_[pos_++];
+        } else if ((c >= '0' && c <= '9') || c == '?' || c == '#' ||
+                   c == '@' || c == '*' || c == '$') {
+            name = c;
+            pos_++;
+        } else if (c == '(') {
+            return fail("command substitution is not supported");
+        } else {
+            add_text(tok, quoted, "$");
+            return true;
+        }
+        tok.parts.push_back(WordPart{true, quoted, name});
+        return true;
+    }
+
+    bool read_word(Token &tok) {
+        while (pos_ < src_.size() && !is_meta(src_[pos_])) {
+            char c = src_[pos_];
+            if (c == '\'') {
+                size_t end = src_.find('\'', pos_ + 1);
+                if (end == std::string::npos) return fail("unterminated single quote");
+                std::string text = src_.substr(pos_ + 1, end - pos_ - 1);
+                for (char t : text)
+                    if (t == '\n') line_++;
+                add_text(tok, true, text);
+                pos_ = end + 1;
+            } else if (c == '"') {
+                pos_++;
+                size_t parts_before = tok.parts.size();
+                size_t text_before = parts_before ? tok.parts.back().text.size() : 0;
+                for (;;) {
+                    if (pos_ >= src_.size()) return fail("unterminated double quote");
+                    char d = src_[pos_];
+                    if (d == '"') {
+                        pos_++;
+                        // Пустые "" тоже дают слово; "$@" без аргументов — нет
+                        if (tok.parts.size() == parts_before &&
+                            (!parts_before || tok.parts.back().text.size() == text_before))
+                            tok.parts.push_back(WordPart{false, true, ""});
+                        break;
+                    }
+                    if (d == '\\' && peek(1) != '\0' && strchr("$`\"\\\n", peek(1))) {
+                        if (peek(1) == '\n') line_++;
+                        else add_text(tok, true, std::string(1, peek(1)));
+                        pos_ += 2;
+                    } else if (d == '$') {
+                        if (!read_var(tok, true)) return false;
+                    } else {
+                        if (d == '\n') line_++;
+                        add_text(tok, true, std::string(1, d));
+                        pos_++;
+                    }
+                }
+            } else if (c == '\\') {
+                // Экранируются только спецсимволы: \e, \l, \q и \n в printf
+                // остаются как в интерактивном режиме
+                char n = peek(1);
+                if (n == '\n') {
+                    pos_ += 2;
+                    line_++;
+                } else if (n != '\0' && strchr(" \t;&|()<>'\"$\\#", n)) {
+                    add_text(tok, true, std::string(1, n));
+                    pos_ += 2;
+                } else {
+                    add_text(tok, false, "\\");
+                    pos_++;
+                }
+            } else if (c == '$') {
+                if (!read_var(tok, false)) return false;
+            } else {
+                size_t start = pos_;
+                while (pos_ < src_.size() && !is_meta(src_[pos_]) &&
+                       !strchr("'\"\\$", src_[pos_]))
+                    pos_++;
+                add_text(tok, false, src_.substr(start, pos_ - start));
+            }
+        }
+
+        tok.plain = tok.parts.size() == 1 && !tok.parts[0].var && !tok.parts[0].quoted;
+        if (tok.plain) tok.literal = tok.parts[0].text;
+        return true;
+    }
+};
+
+// =========================
+// Парсер
+// =========================
+
+class Parser {
+public:
+    Parser(const std::string &src, AstBuilder &b) : lex_(src), b_(b) {}
+
+    std::string error;
+
+    bool parse() {
+        if (!advance()) return false;
+        parse_list();
+        if (!error.empty()) return false;
+        if (tok_.type != T_EOF) return unexpected();
+        return true;
+    }
+
+private:
+    Lexer lex_;
+    AstBuilder &b_;
+    Token tok_;
+
+    bool advance() {
+        if (!lex_.next(tok_)) {
+            if (error.empty()) error = lex_.error;
+            tok_.type = T_EOF;
+            return false;
+        }
+        return true;
+    }
+
+    bool fail(const std::string &msg) {
+        if (error.empty()) error = "line " + std::to_string(tok_.line) + ": " + msg;
+        return false;
+    }
+
+    bool unexpected() {
+        std::string what;
+        switch (tok_.type) {
+            case T_WORD: what = tok_.plain ? tok_.literal : "word"; break;
+            case T_NEWLINE: what = "newline"; break;
+            case T_SEMI: what = ";"; break;
+            case T_AND: what = "&&"; break;
+            case T_OR: what = "||"; break;
+            case T_LPAREN: what = "("; break;
+            case T_RPAREN: what = ")"; break;
+            case T_EOF: what = "end of file"; break;
+        }
+        return fail("syntax error near unexpected token '" + what + "'");
+    }
+
+    bool is_reserved(const char *w) const {
+        return tok_.type == T_WORD && tok_.plain && tok_.literal == w;
+    }
+
+    bool expect_reserved(const char *w) {
+        if (!error.empty()) return false;
+        if (!is_reserved(w)) return fail(std::string("expected '") + w + "'");
+        return advance();
+    }
+
+    void skip_newlines() {
+        while (error.empty() && tok_.type == T_NEWLINE) advance();
+    }
+
+    bool at_list_end() const {
+        return tok_.type == T_EOF || tok_.type == T_RPAREN ||
+               is_reserved("then") || is_reserved("elif") || is_reserved("else") ||
+               is_reserved("fi") || is_reserved("do") || is_reserved("done") ||
+               is_reserved("}");
+    }
+
+    uint32_t parse_list() {
+        std::vector<uint32_t> items;
+        skip_newlines();
+        while (error.empty() && !at_list_end()) {
+            uint32_t n = parse_and_or();
+            if (!error.empty()) return 0;
+            items.push_back(n);
+            if (tok_.type != T_SEMI && tok_.type != T_NEWLINE) break;
+            advance();
+            skip_newlines();
+        }
+        if (!error.empty()) return 0;
+        if (!at_list_end()) {
+            unexpected();
+            return 0;
+        }
+        uint32_t start = b_.add_refs(items);
+        return b_.add(N_LIST, start, items.size());
+    }
+
+    uint32_t parse_and_or() {
+        uint32_t left = parse_pipeline();
+        while (error.empty() && (tok_.type == T_AND || tok_.type == T_OR)) {
+            uint32_t kind = tok_.type == T_AND ? N_AND : N_OR;
+            advance();
+            skip_newlines();
+            uint32_t right = parse_pipeline();
+            if (!error.empty()) return 0;
+            left = b_.add(kind, left, right);
+        }
+        return left;
+    }
+
+    uint32_t parse_pipeline() {
+        if (is_reserved("!")) {
+            advance();
+            uint32_t n = parse_command();
+            if (!error.empty()) return 0;
+            return b_.add(N_NOT, n);
+        }
+        return parse_command();
+    }
+
+    uint32_t parse_command() {
+        if (tok_.type != T_WORD) {
+            unexpected();
+            return 0;
+        }
+        if (is_reserved("if")) {
+            advance();
+            return parse_if_rest();
+        }
+        if (is_reserved("while") || is_reserved("until")) return parse_while();
+        if (is_reserved("for")) return parse_for();
+        if (is_reserved("{")) {
+            advance();
+            uint32_t body = parse_list();
+            expect_reserved("}");
+            return body;
+        }
+        if (at_list_end()) {
+            unexpected();
+            return 0;
+        }
+        return parse_simple();
+    }
+
+    // После if/elif: условие, then, необязательные elif/else, fi
+    uint32_t parse_if_rest() {
+        uint32_t cond = parse_list();
+        if (!expect_reserved("then")) return 0;
+        uint32_t body = parse_list();
+        if (!error.empty()) return 0;
+
+        uint32_t else_node = 0;
+        if (is_reserved("elif")) {
+            advance();
+            else_node = parse_if_rest();
+        } else {
+            if (is_reserved("else")) {
+                advance();
+                else_node = parse_list();
+            }
+            expect_reserved("fi");
+        }
+        if (!error.empty()) return 0;
+        return b_.add(N_IF, cond, body, else_node);
+    }
+
+    uint32_t parse_while() {
+        bool until = is_reserved("until");
+        advance();
+        uint32_t cond = parse_list();
+        if (!expect_reserved("do")) return 0;
+        uint32_t body = parse_list();
+        if (!expect_reserved("done")) return 0;
+        return b_.add(N_WHILE, cond, body, until ? 1 : 0);
+    }
+
+    uint32_t parse_for() {
+        advance();
+        if (tok_.type != T_WORD || !tok_.plain || !is_valid_name(tok_.literal)) {
+            fail("bad for loop variable");
+            return 0;
+        }
+        std::string name = tok_.literal;
+        advance();
+
+        uint32_t words = 0;
+        skip_newlines();
+        if (is_reserved("in")) {
+            advance();
+            std::vector<uint32_t> items;
+            while (error.empty() && tok_.type == T_WORD) {
+                items.push_back(make_word(tok_.parts));
+                advance();
+            }
+            uint32_t start = b_.add_refs(items);
+            words = b_.add(N_LIST, start, items.size());
+        }
+        if (tok_.type == T_SEMI) advance();
+        skip_newlines();
+
+        if (!expect_reserved("do")) return 0;
+        uint32_t body = parse_list();
+        if (!expect_reserved("done")) return 0;
+        uint32_t off = b_.add_string(name);
+        return b_.add(N_FOR, off, name.size(), words, body);
+    }
+
+    uint32_t make_word(const std::vector<WordPart> &parts) {
+        std::vector<uint32_t> items;
+        for (auto &p : parts) {
+            uint32_t off = b_.add_string(p.text);
+            items.push_back(b_.add(p.var ? N_VAR : N_LIT, off, p.text.size(), p.quoted));
+        }
+        uint32_t start = b_.add_refs(items);
+        return b_.add(N_WORD, start, items.size());
+    }
+
+    // NAME=value: имя — начало первой части без кавычек
+    bool is_assignment(const Token &t) const {
+        if (t.parts.empty() || t.parts[0].var || t.parts[0].quoted) return false;
+        size_t eq = t.parts[0].text.find('=');
+        return eq != std::string::npos && is_valid_name(t.parts[0].text.substr(0, eq));
+    }
+
+    uint32_t parse_simple() {
+        std::vector<uint32_t> assigns;
+        std::vector<uint32_t> words;
+
+        while (error.empty() && tok_.type == T_WORD) {
+            if (words.empty() && is_assignment(tok_)) {
+                std::vector<WordPart> parts = tok_.parts;
+                size_t eq = parts[0].text.find('=');
+                std::string name = parts[0].text.substr(0, eq);
+                parts[0].text.erase(0, eq + 1);
+                uint32_t value = make_word(parts);
+                uint32_t off = b_.add_string(name);
+                assigns.push_back(b_.add(N_ASSIGN, off, name.size(), value));
+                advance();
+                continue;
+            }
+
+            bool first = words.empty() && assigns.empty();
+            bool plain = tok_.plain;
+            std::string literal = tok_.literal;
+            words.push_back(make_word(tok_.parts));
+            advance();
+
+            // name() { ... }
+            if (first && tok_.type == T_LPAREN) {
+                if (!plain || !is_valid_name(literal)) {
+                    fail("bad function name");
+                    return 0;
+                }
+                advance();
+                if (tok_.type != T_RPAREN) {
+                    unexpected();
+                    return 0;
+                }
+                advance();
+                skip_newlines();
+                uint32_t body = parse_command();
+                if (!error.empty()) return 0;
+                uint32_t off = b_.add_string(literal);
+                return b_.add(N_FUNC, off, literal.size(), body);
+            }
+        }
+        if (!error.empty()) return 0;
+
+        uint32_t a = b_.add_refs(assigns);
+        uint32_t c = b_.add_refs(words);
+        return b_.add(N_CMD, a, assigns.size(), c, words.size());
+    }
+};
+
+// =========================
+// Проверка образа из кеша
+// =========================
+
+static bool validate_image(const ScriptImage &img) {
+    if (img.node_count < 2 || img.root != img.node_count - 1) return false;
+    if (img.nodes[0].kind != N_NONE) return false;
+
+    auto str_ok = [&](uint32_t off, uint32_t len) {
+        return (uint64_t)off + len <= img.string_size;
+    };
+    auto refs_ok = [&](uint32_t start, uint32_t count) {
+        return (uint64_t)start + count <= img.ref_count;
+    };
+    auto child_ok = [&](uint32_t child, uint32_t self) {
+        return child > 0 && child < self;
+    };
+    auto kind_is = [&](uint32_t idx, uint32_t kind) {
+        return img.nodes[idx].kind == kind;
+    };
+
+    for (uint32_t i = 1; i < img.node_count; i++) {
+        const AstNode &n = img.nodes[i];
+        switch (n.kind) {
+            case N_LIST:
+                if (!refs_ok(n.a, n.b)) return false;
+                for (uint32_t k = 0; k < n.b; k++)
+                    if (!child_ok(img.refs[n.a + k], i)) return false;
+                break;
+            case N_CMD:
+                if (!refs_ok(n.a, n.b) || !refs_ok(n.c, n.d)) return false;
+                for (uint32_t k = 0; k < n.b; k++) {
+                    uint32_t ch = img.refs[n.a + k];
+                    if (!child_ok(ch, i) || !kind_is(ch, N_ASSIGN)) return false;
+                }
+                for (uint32_t k = 0; k < n.d; k++) {
+                    uint32_t ch = img.refs[n.c + k];
+                    if (!child_ok(ch, i) || !kind_is(ch, N_WORD)) return false;
+                }
+                break;
+            case N_ASSIGN:
+                if (!str_ok(n.a, n.b) || !child_ok(n.c, i) || !kind_is(n.c, N_WORD))
+                    return false;
+                break;
+            case N_WORD:
+                if (!refs_ok(n.a, n.b)) return false;
+                for (uint32_t k = 0; k < n.b; k++) {
+                    uint32_t ch = img.refs[n.a + k];
+                    if (!child_ok(ch, i) || !(kind_is(ch, N_LIT) || kind_is(ch, N_VAR)))
+                        return false;
+                }
+                break;
+            case N_LIT:
+            case N_VAR:
+                if (!str_ok(n.a, n.b)) return false;
+                break;
+            case N_AND:
+            case N_OR:
+                if (!child_ok(n.a, i) || !child_ok(n.b, i)) return false;
+                break;
+            case N_NOT:
+                if (!child_ok(n.a, i)) return false;
+                break;
+            case N_IF:
+                if (!child_ok(n.a, i) || !child_ok(n.b, i) || (n.c && !child_ok(n.c, i)))
+                    return false;
+                break;
+            case N_WHILE:
+                if (!child_ok(n.a, i) || !child_ok(n.b, i)) return false;
+                break;
+            case N_FOR:
+                if (!str_ok(n.a, n.b) || !child_ok(n.d, i)) return false;
+                if (n.c) {
+                    if (!child_ok(n.c, i) || !kind_is(n.c, N_LIST)) return false;
+                    const AstNode &w = img.nodes[n.c];
+                    for (uint32_t k = 0; k < w.b; k++)
+                        if (!kind_is(img.refs[w.a + k], N_WORD)) return false;
+                }
+                break;
+            case N_FUNC:
+                if (!str_ok(n.a, n.b) || !child_ok(n.c, i)) return false;
+                break;
+            default:
+                return false;
+        }
+    }
+    return true;
+}
+
+// =========================
+// Интерпретатор
+// =========================
+
+class Interpreter {
+public:
+    Interpreter(const ScriptImage &img, const std::vector<std::string> &args,
+                command_runner run)
+        : img_(img), args_(args), run_(run) {
+        if (args_.empty()) args_.push_back("kubsh");
+    }
+
+    int run() {
+        exec(img_.root);
+        return status_;
+    }
+
+private:
+    enum Flow { FLOW_NORMAL, FLOW_BREAK, FLOW_CONTINUE, FLOW_RETURN, FLOW_EXIT };
+
+    const ScriptImage &img_;
+    std::vector<std::string> args_;
+    command_runner run_;
+    std::unordered_map<std::string, uint32_t> functions_;
+    // Переменные shell; в окружение попадают только экспортированные
+    // (унаследованные из окружения или перечисленные в export)
+    std::unordered_map<std::string, std::string> vars_;
+    std::unordered_set<std::string> exported_;
+    Flow flow_ = FLOW_NORMAL;
+    int status_ = 0;
+    int loop_depth_ = 0;
+    int call_depth_ = 0;
+
+    std::string str(uint32_t off, uint32_t len) const {
+        return std::string(img_.strings + off, len);
+    }
+
+    std::string var_value(const std::string &name) const {
+        if (name == "?") return std::to_string(status_);
+        if (name == "#") return std::to_string(args_.size() - 1);
+        if (name == "$") return std::to_string(getpid());
+        if (name == "@" || name == "*") {
+            std::string out;
+            for (size_t i = 1; i < args_.size(); i++) {
+                if (i > 1) out += ' ';
+                out += args_[i];
+            }
+            return out;
+        }
+        if (name[0] >= '0' && name[0] <= '9') {
+            size_t n = strtoul(name.c_str(), NULL, 10);
+            return n < args_.size() ? args_[n] : "";
+        }
+        auto it = vars_.find(name);
+        if (it != vars_.end()) return it->second;
+        const char *v = getenv(name.c_str());
+        return v ? v : "";
+    }
+
+    bool is_exported(const std::string &name) const {
+        return exported_.count(name) || getenv(name.c_str()) != NULL;
+    }
+
+    void set_var(const std::string &name, const std::string &value) {
+        vars_[name] = value;
+        if (is_exported(name)) setenv(name.c_str(), value.c_str(), 1);
+    }
+
+    // Раскрывает слово в поля; split = false — без разбиения (присваивания)
+    void expand_word(uint32_t w, std::vector<std::string> &out, bool split) const {
+        const AstNode &wn = img_.nodes[w];
+
+        // Частый случай: одно слово без переменных
+        if (wn.b == 1) {
+            const AstNode &p = img_.nodes[img_.refs[wn.a]];
+            if (p.kind == N_LIT) {
+                out.push_back(str(p.a, p.b));
+                return;
+            }
+        }
+
+        std::string cur;
+        bool have = false;
+        for (uint32_t k = 0; k < wn.b; k++) {
+            const AstNode &p = img_.nodes[img_.refs[wn.a + k]];
+            if (p.kind == N_LIT) {
+                cur.append(img_.strings + p.a, p.b);
+                if (p.c || p.b) have = true;
+                continue;
+            }
+
+            std::string name = str(p.a, p.b);
+            if (name == "@" && p.c && split) {
+                // "$@" — каждый аргумент отдельным полем
+                for (size_t i = 1; i < args_.size(); i++) {
+                    if (i > 1) {
+                        out.push_back(cur);
+                        cur.clear();
+                    }
+                    cur += args_[i];
+                    have = true;
+                }
+                continue;
+            }
+
+            std::string v = var_value(name);
+            if (p.c || !split) {
+                cur += v;
+                if (p.c || !v.empty()) have = true;
+                continue;
+            }
+
+            // Без кавычек значение разбивается по пробелам
+            size_t i = 0;
+            while (i < v.size()) {
+                if (isspace((unsigned char)v[i])) {
+                    if (have) {
+                        out.push_back(cur);
+                        cur.clear();
+                        have = false;
+                    }
+                    while (i < v.size() && isspace((unsigned char)v[i])) i++;
+                    continue;
+                }
+                size_t j = i;
+                while (j < v.size() && !isspace((unsigned char)v[j])) j++;
+                cur.append(v, i, j - i);
+                have = true;
+                i = j;
+            }
+        }
+        if (have) out.push_back(cur);
+    }
+
+    std::string expand_value(uint32_t w) const {
+        std::vector<std::string> parts;
+        expand_word(w, parts, false);
+        return parts.empty() ? "" : parts[0];
+    }
+
+    int exec(uint32_t idx) {
+        const AstNode &n = img_.nodes[idx];
+        switch (n.kind) {
+            case N_LIST:
+                for (uint32_t k = 0; k < n.b && flow_ == FLOW_NORMAL; k++)
+                    exec(img_.refs[n.a + k]);
+                return status_;
+
+            case N_CMD:
+                return status_ = exec_command(n);
+
+            case N_AND:
+            case N_OR: {
+                int left = exec(n.a);
+                if (flow_ != FLOW_NORMAL) return status_;
+                if ((n.kind == N_AND) == (left == 0)) exec(n.b);
+                return status_;
+            }
+
+            case N_NOT:
+                exec(n.a);
+                if (flow_ == FLOW_NORMAL) status_ = status_ == 0 ? 1 : 0;
+                return status_;
+
+            case N_IF: {
+                int cond = exec(n.a);
+                if (flow_ != FLOW_NORMAL) return status_;
+                if (cond == 0) return exec(n.b);
+                if (n.c) return exec(n.c);
+                return status_ = 0;
+            }
+
+            case N_WHILE: {
+                int last = 0;
+                loop_depth_++;
+                for (;;) {
+                    int cond = exec(n.a);
+                    if (flow_ != FLOW_NORMAL) break;
+                    if ((cond == 0) == (n.c != 0)) break;
+                    last = exec(n.b);
+                    if (flow_ == FLOW_CONTINUE) flow_ = FLOW_NORMAL;
+                    if (flow_ == FLOW_BREAK) {
+                        flow_ = FLOW_NORMAL;
+                        break;
+                    }
+                    if (flow_ != FLOW_NORMAL) break;
+                }
+                loop_depth_--;
+                if (flow_ == FLOW_NORMAL) status_ = last;
+                return status_;
+            }
+
+            case N_FOR: {
+                std::vector<std::string> items;
+                if (n.c) {
+                    const AstNode &w = img_.nodes[n.c];
+                    for (uint32_t k = 0; k < w.b; k++)
+                        expand_word(img_.refs[w.a + k], items, true);
+                } else {
+                    items.assign(args_.begin() + 1, args_.end());
+                }
+
+                std::string name = str(n.a, n.b);
+                int last = 0;
+                loop_depth_++;
+                for (auto &item : items) {
+                    set_var(name, item);
+                    last = exec(n.d);
+                    if (flow_ == FLOW_CONTINUE) flow_ = FLOW_NORMAL;
+                    if (flow_ == FLOW_BREAK) {
+                        flow_ = FLOW_NORMAL;
+                        break;
+                    }
+                    if (flow_ != FLOW_NORMAL) break;
+                }
+                loop_depth_--;
+                if (flow_ == FLOW_NORMAL) status_ = last;
+                return status_;
+            }
+
+            case N_FUNC:
+                functions_[str(n.a, n.b)] = n.c;
+                return status_ = 0;
+        }
+        return status_;
+    }
+
+    int exec_command(const AstNode &n) {
+        std::vector<std::string> fields;
+        for (uint32_t k = 0; k < n.d; k++)
+            expand_word(img_.refs[n.c + k], fields, true);
+
+        // Только присваивания — меняют переменные shell
+        if (fields.empty()) {
+            for (uint32_t k = 0; k < n.b; k++) {
+                const AstNode &as = img_.nodes[img_.refs[n.a + k]];
+                set_var(str(as.a, as.b), expand_value(as.c));
+            }
+            return 0;
+        }
+
+        const std::string &name = fields[0];
+        int special;
+        if (exec_special(fields, &special)) return special;
+
+        // NAME=value cmd — переменная видна только этой команде
+        // (в её окружении и, для функций, в переменных shell)
+        std::vector<std::pair<std::string, std::string>> saved, saved_vars;
+        std::vector<std::string> unset_after, erase_after;
+        for (uint32_t k = 0; k < n.b; k++) {
+            const AstNode &as = img_.nodes[img_.refs[n.a + k]];
+            std::string var = str(as.a, as.b);
+            std::string value = expand_value(as.c);
+            const char *old = getenv(var.c_str());
+            if (old) saved.emplace_back(var, old);
+            else unset_after.push_back(var);
+            auto it = vars_.find(var);
+            if (it != vars_.end()) saved_vars.emplace_back(var, it->second);
+            else erase_after.push_back(var);
+            setenv(var.c_str(), value.c_str(), 1);
+            vars_[var] = value;
+        }
+
+        int ret;
+        auto fn = functions_.find(name);
+        if (fn != functions_.end()) {
+            ret = call_function(fn->second, fields);
+        } else {
+            std::string command = fields[0];
+            for (size_t i = 1; i < fields.size(); i++) command += " " + fields[i];
+            ret = run_(fields, command);
+        }
+
+        for (auto &s : saved) setenv(s.first.c_str(), s.second.c_str(), 1);
+        for (auto &u : unset_after) unsetenv(u.c_str());
+        for (auto &s : saved_vars) vars_[s.first] = s.second;
+        for (auto &u : erase_after) vars_.erase(u);
+        return ret;
+    }
+
+    int call_function(uint32_t body, const std::vector<std::string> &fields) {
+        if (call_depth_ >= 1000) {
+            std::cerr << "kubsh: " << fields[0] << ": maximum function nesting exceeded" << '\n';
+            return 1;
+        }
+
+        std::vector<std::string> saved_args = args_;
+        args_.assign(fields.begin(), fields.end());
+        args_[0] = saved_args[0];
+        int saved_loops = loop_depth_;
+        loop_depth_ = 0;
+        call_depth_++;
+
+        exec(body);
+
+        call_depth_--;
+        loop_depth_ = saved_loops;
+        args_.swap(saved_args);
+        if (flow_ == FLOW_RETURN) flow_ = FLOW_NORMAL;
+        return status_;
+    }
+
+    static bool parse_status(const std::string &s, int *out) {
+        char *end = NULL;
+        long v = strtol(s.c_str(), &end, 10);
+        if (s.empty() || *end != '\0') return false;
+        *out = (int)(v & 0xff);
+        return true;
+    }
+
+    // Команды, управляющие самим интерпретатором
+    bool exec_special(const std::vector<std::string> &fields, int *ret) {
+        const std::string &name = fields[0];
+
+        if (name == "exit" || name == "\\q" || name == "return") {
+            int code = status_;
+            if (fields.size() > 1 && !parse_status(fields[1], &code)) {
+                std::cerr << "kubsh: " << name << ": " << fields[1]
+                          << ": numeric argument required" << '\n';
+                code = 2;
+            }
+            flow_ = (name == "return" && call_depth_ > 0) ? FLOW_RETURN : FLOW_EXIT;
+            *ret = status_ = code;
+            return true;
+        }
+
+        if (name == "break" || name == "continue") {
+            if (loop_depth_ > 0) flow_ = name == "break" ? FLOW_BREAK : FLOW_CONTINUE;
+            *ret = 0;
+            return true;
+        }
+
+        if (name == ":") {
+            *ret = 0;
+            return true;
+        }
+
+        if (name == "shift") {
+            int count = 1;
+            if (fields.size() > 1 && !parse_status(fields[1], &count)) count = -1;
+            if (count < 0 || (size_t)count >= args_.size()) {
+                *ret = 1;
+                return true;
+            }
+            args_.erase(args_.begin() + 1, args_.begin() + 1 + count);
+            *ret = 0;
+            return true;
+        }
+
+        // export NAME[=value] — переменная попадает в окружение команд
+        if (name == "export") {
+            for (size_t i = 1; i < fields.size(); i++) {
+                size_t eq = fields[i].find('=');
+                std::string var = fields[i].substr(0, eq);
+                exported_.insert(var);
+                if (eq != std::string::npos) {
+                    set_var(var, fields[i].substr(eq + 1));
+                } else {
+                    auto it = vars_.find(var);
+                    if (it != vars_.end()) setenv(var.c_str(), it->second.c_str(), 1);
+                }
+            }
+            *ret = 0;
+            return true;
+        }
+
+        return false;
+    }
+};
+
+// =========================
+// Кеш AST на диске
+// =========================
+//
+// Файл: заголовок | узлы | refs | строки | путь к скрипту.
+// Имя файла — хеш realpath скрипта; mtime и размер сверяются при загрузке.
+
+static const char cache_magic[8] = {'K', 'U', 'B', 'S', 'H', 'A', 'S', 'T'};
+static const uint32_t cache_version = 2;
+
+struct CacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t node_count;
+    uint32_t ref_count;
+    uint32_t string_size;
+    int64_t src_mtime_sec;
+    int64_t src_mtime_nsec;
+    int64_t src_size;
+    int64_t src_ino;
+    uint32_t path_len;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(CacheHeader) % 4 == 0, "cache sections must stay 4-byte aligned");
+
+static std::string cache_file_for(const std::string &real_path) {
+    std::string dir;
+    const char *xdg = getenv("XDG_CACHE_HOME");
+    if (xdg && *xdg) {
+        dir = xdg;
+    } else {
+        const char *home = getenv("HOME");
+        if (!home || !*home) return "";
+        dir = std::string(home) + "/.cache";
+    }
+    mkdir(dir.c_str(), 0700);
+    dir += "/kubsh";
+    if (mkdir(dir.c_str(), 0700) != 0 && errno != EEXIST) return "";
+
+    uint64_t h = 14695981039346656037ull;
+    for (unsigned char c : real_path) {
+        h ^= c;
+        h *= 1099511628211ull;
+    }
+    char name[32];
+    snprintf(name, sizeof(name), "/%016llx.ast", (unsigned long long)h);
+    return dir + name;
+}
+
+static bool header_matches(const CacheHeader &h, const struct stat &st) {
+    return memcmp(h.magic, cache_magic, sizeof(cache_magic)) == 0 &&
+           h.version == cache_version &&
+           h.src_mtime_sec == (int64_t)st.st_mtim.tv_sec &&
+           h.src_mtime_nsec == (int64_t)st.st_mtim.tv_nsec &&
+           h.src_size == (int64_t)st.st_size &&
+           h.src_ino == (int64_t)st.st_ino;
+}
+
+// Отображённый в память кеш; img указывает прямо в mmap
+struct MappedScript {
+    void *addr = MAP_FAILED;
+    size_t len = 0;
+    ScriptImage img{};
+
+    ~MappedScript() {
+        if (addr != MAP_FAILED) munmap(addr, len);
+    }
+
+    bool load(const std::string &cache, const std::string &real_path,
+              const struct stat &src) {
+        int fd = open(cache.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return false;
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(CacheHeader)) {
+            close(fd);
+            return false;
+        }
+        len = st.st_size;
+        addr = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (addr == MAP_FAILED) return false;
+
+        const char *base = (const char *)addr;
+        const CacheHeader *h = (const CacheHeader *)base;
+        if (!header_matches(*h, src) || h->path_len != real_path.size()) return false;
+
+        uint64_t expected = sizeof(CacheHeader) +
+                            (uint64_t)h->node_count * sizeof(AstNode) +
+                            (uint64_t)h->ref_count * sizeof(uint32_t) +
+                            h->string_size + h->path_len;
+        if (expected != len) return false;
+
+        const char *p = base + sizeof(CacheHeader);
+        img.nodes = (const AstNode *)p;
+        img.node_count = h->node_count;
+        p += (size_t)h->node_count * sizeof(AstNode);
+        img.refs = (const uint32_t *)p;
+        img.ref_count = h->ref_count;
+        p += (size_t)h->ref_count * sizeof(uint32_t);
+        img.strings = p;
+        img.string_size = h->string_size;
+        p += h->string_size;
+        img.root = h->node_count ? h->node_count - 1 : 0;
+
+        if (memcmp(p, real_path.data(), h->path_len) != 0) return false;
+        return validate_image(img);
+    }
+};
+
+static bool write_all(int fd, const void *data, size_t len) {
+    const char *p = (const char *)data;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+// Пишет во временный файл и переименовывает: читатели не видят половину
+static void store_cache(const std::string &cache, const std::string &real_path,
+                        const struct stat &src, const AstBuilder &b) {
+    CacheHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, cache_magic, sizeof(cache_magic));
+    h.version = cache_version;
+    h.node_count = b.nodes.size();
+    h.ref_count = b.refs.size();
+    h.string_size = b.strings.size();
+    h.src_mtime_sec = src.st_mtim.tv_sec;
+    h.src_mtime_nsec = src.st_mtim.tv_nsec;
+    h.src_size = src.st_size;
+    h.src_ino = src.st_ino;
+    h.path_len = real_path.size();
+
+    std::string tmp = cache + ".tmp." + std::to_string(getpid());
+    int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) return;
+
+    bool ok = write_all(fd, &h, sizeof(h)) &&
+              write_all(fd, b.nodes.data(), b.nodes.size() * sizeof(AstNode)) &&
+              write_all(fd, b.refs.data(), b.refs.size() * sizeof(uint32_t)) &&
+              write_all(fd, b.strings.data(), b.strings.size()) &&
+              write_all(fd, real_path.data(), real_path.size());
+    if (close(fd) != 0) ok = false;
+
+    if (!ok || rename(tmp.c_str(), cache.c_str()) != 0) unlink(tmp.c_str());
+}
+
+static bool read_source(int fd, std::string &out) {
+    char buf[65536];
+    for (;;) {
+        ssize_t n = read(fd, buf, sizeof(buf));
+        if (n == 0) return true;
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        out.append(buf, n);
+    }
+}
+
+// =========================
+// Точки входа
+// =========================
+
+int run_script_string(const std::string &source, const std::vector<std::string> &args,
+                      command_runner run) {
+    AstBuilder b;
+    Parser parser(source, b);
+    if (!parser.parse()) {
+        std::cerr << "kubsh: -c: " << parser.error << '\n';
+        return 2;
+    }
+    ScriptImage img = b.image();
+    Interpreter interp(img, args, run);
+    return interp.run();
+}
+
+int run_script_file(const std::string &path, const std::vector<std::string> &args,
+                    command_runner run) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        std::cerr << "kubsh: " << path << ": " << strerror(errno) << '\n';
+        return 127;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        std::cerr << "kubsh: " << path << ": " << strerror(errno) << '\n';
+        close(fd);
+        return 126;
+    }
+
+    bool use_cache = getenv("KUBSH_NO_AST_CACHE") == NULL && S_ISREG(st.st_mode);
+    std::string real_path, cache;
+    if (use_cache) {
+        char resolved[PATH_MAX];
+        if (realpath(path.c_str(), resolved)) {
+            real_path = resolved;
+            cache = cache_file_for(real_path);
+        }
+    }
+
+    // Горячий путь: AST уже разобран, берём его через mmap
+    if (!cache.empty()) {
+        MappedScript mapped;
+        if (mapped.load(cache, real_path, st)) {
+            close(fd);
+            Interpreter interp(mapped.img, args, run);
+            return interp.run();
+        }
+    }
+
+    std::string source;
+    if (!read_source(fd, source)) {
+        std::cerr << "kubsh: " << path << ": " << strerror(errno) << '\n';
+        close(fd);
+        return 126;
+    }
+
+    // Файл поменялся во время чтения — не кешируем
+    struct stat after;
+    if (fstat(fd, &after) != 0 || after.st_size != st.st_size ||
+        after.st_mtim.tv_sec != st.st_mtim.tv_sec ||
+        after.st_mtim.tv_nsec != st.st_mtim.tv_nsec)
+        cache.clear();
+    close(fd);
+
+    AstBuilder b;
+    Parser parser(source, b);
+    if (!parser.parse()) {
+        std::cerr << "kubsh: " << path << ": " << parser.error << '\n';
+        return 2;
+    }
+
+    if (!cache.empty()) store_cache(cache, real_path, st, b);
+
+    ScriptImage img = b.image();
+    Interpreter interp(img, args, run);
+    return interp.run();
+}
@@ -0,0 +1,22 @@
+#ifndef SCRIPT_H
+#define SCRIPT_H
+
+#include <string>
+#include <vector>
+
+// Выполняет одну простую команду (встроенную или внешнюю), возвращает код
+typedef int (*command_runner)(const std::vector<std::string> &tokens,
+                              const std::string &command);
+
+// kubsh script.ksh [args...]
+// Разобранное AST кешируется на диске (ключ — путь, mtime и размер)
+// и при следующем запуске отображается в память через mmap.
+// args[0] — имя скрипта ($0). Возвращает код завершения скрипта.
+int run_script_file(const std::string &path, const std::vector<std::string> &args,
+                    command_runner run);
+
+// kubsh -c '...' [args...] — без кеша
+int run_script_string(const std::string &source, const std::vector<std::string> &args,
+                      command_runner run);
+
+#endif
@@ -0,0 +1,968 @@
+#define _GNU_SOURCE
+#include "user_attrs.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <grp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <time.h>
+#include <utmp.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+
+#define WORKER_COUNT 2            // размер пула фоновых потоков
+#define QUEUE_CAP 64              // максимум ожидающих заданий
+#define ATTR_TTL 30               // через сколько секунд значение устаревает
+#define USAGE_TTL 600             // полный пересчёт du при работающем inotify
+#define MAX_WATCHES 8192          // на весь процесс: лимит max_user_watches общий
+                                  // для всех программ пользователя
+
+#define WATCH_MASK (IN_CREATE | IN_DELETE | IN_MODIFY | IN_MOVED_FROM | \
+                    IN_MOVED_TO | IN_MOVE_SELF | IN_DELETE_SELF | IN_ONLYDIR | \
+                    IN_DONT_FOLLOW | IN_EXCL_UNLINK)
+
+static const char *attr_names[USER_ATTR_COUNT] = {
+    "groups",
+    "disk_usage",
+    "file_count",
+    "last_login",
+};
+
+struct attr_entry {
+    char *name;
+    char *home;
+    gid_t gid;
+    char *value[USER_ATTR_COUNT];
+    time_t updated[USER_ATTR_COUNT];
+    int pending[USER_ATTR_COUNT];
+
+    // Состояние du: суммы по всем отслеживаемым каталогам
+    unsigned long long usage_bytes;
+    unsigned long long usage_files;
+    dev_t dev;
+    int watch_complete;
+    unsigned scan_gen;
+
+    off_t wtmp_size;
+    struct attr_entry *next;
+};
+
+// Каталог под inotify; bytes/files — только его непосредственное содержимое
+struct watched_dir {
+    struct attr_entry *owner;
+    char *path;
+    unsigned long long bytes;
+    unsigned long long files;
+    unsigned gen;
+    int deleted;              // пришёл IN_DELETE_SELF
+};
+
+struct scan_dir {
+    int wd;
+    char *path;
+    unsigned long long bytes;
+    unsigned long long files;
+};
+
+struct scan_result {
+    struct scan_dir *dirs;
+    size_t count;
+    size_t cap;
+    unsigned long long bytes;
+    unsigned long long files;
+    int complete;
+    int has_dev;
+    dev_t dev;
+};
+
+struct attr_job {
+    char *name;
+    char *home;
+    gid_t gid;
+    int attr;
+};
+
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t result_cond = PTHREAD_COND_INITIALIZER;
+static struct attr_entry *entries = NULL;
+
+static struct attr_job queue[QUEUE_CAP];
+static int queue_head = 0;
+static int queue_len = 0;
+
+static pthread_t workers[WORKER_COUNT];
+static int worker_count = 0;
+static pthread_t watcher;
+static int watcher_started = 0;
+static atomic_int shutting_down;
+
+static int inotify_fd = -1;
+static int wake_fd = -1;
+static struct watched_dir **watch_table = NULL;
+static int watch_table_cap = 0;
+// Сколько наблюдений добавлено в inotify; сверх MAX_WATCHES — только TTL
+static atomic_int watches_used;
+
+// Точка монтирования VFS (каталог parent + имя): stat на ней ушёл бы
+// в наш же FUSE, поэтому обход её пропускает
+static dev_t mount_parent_dev;
+static ino_t mount_parent_ino;
+static char *mount_name = NULL;
+
+// =========================
+// Вычисление атрибутов
+// =========================
+
+static char *format_ull(unsigned long long v) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%llu", v);
+    return strdup(buf);
+}
+
+static char *path_join(const char *dir, const char *name) {
+    size_t a = strlen(dir), b = strlen(name);
+    char *p = malloc(a + b + 2);
+    if (!p) return NULL;
+    memcpy(p, dir, a);
+    p[a] = '/';
+    memcpy(p + a + 1, name, b + 1);
+    return p;
+}
+
+static char *compute_groups(const char *name, gid_t gid) {
+    int n = 32;
+    gid_t *list = NULL;
+    for (;;) {
+        gid_t *tmp = realloc(list, n * sizeof(gid_t));
+        if (!tmp) {
+            free(list);
+            return NULL;
+        }
+        list = tmp;
+        int got = n;
+        if (getgrouplist(name, gid, list, &got) >= 0) {
+            n = got;
+            break;
+        }
+        n = got > n ? got : n * 2;
+    }
+
+    char *out = NULL;
+    size_t len = 0;
+    FILE *f = open_memstream(&out, &len);
+    if (!f) {
+        free(list);
+        return NULL;
+    }
+
+    char grbuf[16384];
+    for (int i = 0; i < n; i++) {
+        struct group gr, *res = NULL;
+        if (i > 0) fputc(' ', f);
+        if (getgrgid_r(list[i], &gr, grbuf, sizeof(grbuf), &res) == 0 && res)
+            fputs(res->gr_name, f);
+        else
+            fprintf(f, "%u", (unsigned)list[i]);
+    }
+    fclose(f);
+    free(list);
+    return out;
+}
+
+// wtmp читаем с конца: последний вход обычно ближе к концу файла
+static char *compute_last_login(const char *name, off_t *wtmp_size) {
+    int fd = open(_PATH_WTMP, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        *wtmp_size = -1;
+        return strdup("never");
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        *wtmp_size = -1;
+        return strdup("never");
+    }
+    *wtmp_size = st.st_size;
+
+    struct utmp recs[256];
+    off_t pos = st.st_size - st.st_size % sizeof(struct utmp);
+    time_t found = 0;
+
+    while (pos > 0 && !found) {
+        size_t chunk = pos / sizeof(struct utmp);
+        if (chunk > 256) chunk = 256;
+        pos -= chunk * sizeof(struct utmp);
+
+        ssize_t got = pread(fd, recs, chunk * sizeof(struct utmp), pos);
+        if (got < (ssize_t)(chunk * sizeof(struct utmp))) break;
+
+        for (size_t i = chunk; i-- > 0;) {
+            if (recs[i].ut_type == USER_PROCESS &&
+                strncmp(recs[i].ut_user, name, sizeof(recs[i].ut_user)) == 0) {
+                found = recs[i].ut_tv.tv_sec;
+                break;
+            }
+        }
+    }
+    close(fd);
+
+    if (!found) return strdup("never");
+
+    char buf[64];
+    struct tm tm;
+    localtime_r(&found, &tm);
+    strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm);
+    return strdup(buf);
+}
+
+// Непосредственное содержимое каталога: сам каталог + файлы в нём.
+// Подкаталоги на том же устройстве складываются в subdirs (если не NULL).
+static int scan_dir_direct(const char *path, dev_t dev,
+                           unsigned long long *bytes, unsigned long long *files,
+                           struct scan_result *subdirs) {
+    int dfd = open(path, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (dfd < 0) return -1;
+
+    struct stat st;
+    if (fstat(dfd, &st) != 0) {
+        close(dfd);
+        return -1;
+    }
+    *bytes = (unsigned long long)st.st_blocks * 512;
+    *files = 0;
+    int has_mount = mount_name && st.st_dev == mount_parent_dev &&
+                    st.st_ino == mount_parent_ino;
+
+    DIR *d = fdopendir(dfd);
+    if (!d) {
+        close(dfd);
+        return -1;
+    }
+
+    struct dirent *de;
+    while ((de = readdir(d)) != NULL) {
+        if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0)
+            continue;
+        if (has_mount && strcmp(de->d_name, mount_name) == 0)
+            continue;
+        if (fstatat(dfd, de->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0)
+            continue;
+
+        if (S_ISDIR(st.st_mode)) {
+            if (subdirs && st.st_dev == dev) {
+                if (subdirs->count == subdirs->cap) {
+                    size_t cap = subdirs->cap ? subdirs->cap * 2 : 64;
+                    struct scan_dir *tmp = realloc(subdirs->dirs, cap * sizeof(*tmp));
+                    if (!tmp) continue;
+                    subdirs->dirs = tmp;
+                    subdirs->cap = cap;
+                }
+                char *sub = path_join(path, de->d_name);
+                if (!sub) continue;
+                subdirs->dirs[subdirs->count].wd = -1;
+                subdirs->dirs[subdirs->count].path = sub;
+                subdirs->dirs[subdirs->count].bytes = 0;
+                subdirs->dirs[subdirs->count].files = 0;
+                subdirs->count++;
+            }
+        } else {
+            *bytes += (unsigned long long)st.st_blocks * 512;
+            (*files)++;
+        }
+    }
+    closedir(d);
+    return 0;
+}
+
+// Под cache_lock
+static struct watched_dir *watch_get_locked(int wd) {
+    if (wd < 0 || wd >= watch_table_cap) return NULL;
+    return watch_table[wd];
+}
+
+// Обход дерева в ширину; каждый каталог ставится под inotify
+static void scan_tree(const char *root, struct scan_result *r) {
+    struct stat st;
+    if (lstat(root, &st) != 0 || !S_ISDIR(st.st_mode)) return;
+    if (r->has_dev && st.st_dev != r->dev) return;
+    r->dev = st.st_dev;
+    r->has_dev = 1;
+
+    r->dirs = malloc(64 * sizeof(struct scan_dir));
+    if (!r->dirs) return;
+    r->cap = 64;
+    r->count = 1;
+    r->dirs[0].wd = -1;
+    r->dirs[0].path = strdup(root);
+    r->dirs[0].bytes = 0;
+    r->dirs[0].files = 0;
+    if (!r->dirs[0].path) {
+        r->count = 0;
+        return;
+    }
+
+    // Записи добавляются в конец массива по ходу обхода
+    for (size_t i = 0; i < r->count && !atomic_load(&shutting_down); i++) {
+        const char *path = r->dirs[i].path;
+        int wd = -1;
+        if (inotify_fd >= 0 && atomic_load(&watches_used) < MAX_WATCHES)
+            wd = inotify_add_watch(inotify_fd, path, WATCH_MASK);
+        if (wd >= 0) atomic_fetch_add(&watches_used, 1);
+        else r->complete = 0;
+
+        unsigned long long bytes = 0, files = 0;
+        if (scan_dir_direct(path, r->dev, &bytes, &files, r) != 0) {
+            if (wd >= 0) {
+                // inotify мог вернуть уже существующее наблюдение — не наше
+                pthread_mutex_lock(&cache_lock);
+                if (!watch_get_locked(wd)) inotify_rm_watch(inotify_fd, wd);
+                pthread_mutex_unlock(&cache_lock);
+                atomic_fetch_sub(&watches_used, 1);
+            }
+            continue;
+        }
+        r->dirs[i].wd = wd;
+        r->dirs[i].bytes = bytes;
+        r->dirs[i].files = files;
+        r->bytes += bytes;
+        r->files += files;
+    }
+}
+
+static void scan_result_free(struct scan_result *r) {
+    for (size_t i = 0; i < r->count; i++) free(r->dirs[i].path);
+    free(r->dirs);
+    r->dirs = NULL;
+    r->count = r->cap = 0;
+}
+
+// =========================
+// Кеш (все функции *_locked — под cache_lock)
+// =========================
+
+static struct attr_entry *entry_find_locked(const char *name) {
+    for (struct attr_entry *e = entries; e; e = e->next)
+        if (strcmp(e->name, name) == 0) return e;
+    return NULL;
+}
+
+static struct attr_entry *entry_get_locked(const struct passwd *pwd) {
+    struct attr_entry *e = entry_find_locked(pwd->pw_name);
+    if (e) return e;
+
+    e = calloc(1, sizeof(*e));
+    if (!e) return NULL;
+    e->name = strdup(pwd->pw_name);
+    e->home = strdup(pwd->pw_dir ? pwd->pw_dir : "");
+    if (!e->name || !e->home) {
+        free(e->name);
+        free(e->home);
+        free(e);
+        return NULL;
+    }
+    e->gid = pwd->pw_gid;
+    e->wtmp_size = -1;
+    e->next = entries;
+    entries = e;
+    return e;
+}
+
+static void entry_set_value_locked(struct attr_entry *e, int attr, char *value) {
+    if (!value) return;
+    free(e->value[attr]);
+    e->value[attr] = value;
+    e->updated[attr] = time(NULL);
+}
+
+static void entry_set_usage_locked(struct attr_entry *e) {
+    entry_set_value_locked(e, USER_ATTR_DISK_USAGE, format_ull(e->usage_bytes));
+    entry_set_value_locked(e, USER_ATTR_FILE_COUNT, format_ull(e->usage_files));
+}
+
+static int watch_set_locked(int wd, struct watched_dir *w) {
+    if (wd >= watch_table_cap) {
+        int cap = watch_table_cap ? watch_table_cap : 256;
+        while (cap <= wd) cap *= 2;
+        struct watched_dir **tmp = realloc(watch_table, cap * sizeof(*tmp));
+        if (!tmp) return -1;
+        memset(tmp + watch_table_cap, 0, (cap - watch_table_cap) * sizeof(*tmp));
+        watch_table = tmp;
+        watch_table_cap = cap;
+    }
+    watch_table[wd] = w;
+    return 0;
+}
+
+static void watch_drop_locked(int wd, int remove_watch) {
+    struct watched_dir *w = watch_get_locked(wd);
+    if (!w) return;
+    watch_table[wd] = NULL;
+    if (remove_watch) inotify_rm_watch(inotify_fd, wd);
+    atomic_fetch_sub(&watches_used, 1);
+    free(w->path);
+    free(w);
+}
+
+// Переносит результаты обхода в таблицу наблюдения.
+// Обход не попал в таблицу: снимаем его наблюдения. Если wd уже есть
+// в таблице, inotify вернул существующее наблюдение — его не трогаем,
+// но и в счётчике оно учтено дважды.
+static void release_scan_watches_locked(struct scan_result *r) {
+    for (size_t i = 0; i < r->count; i++) {
+        if (r->dirs[i].wd < 0) continue;
+        if (!watch_get_locked(r->dirs[i].wd))
+            inotify_rm_watch(inotify_fd, r->dirs[i].wd);
+        atomic_fetch_sub(&watches_used, 1);
+    }
+}
+
+// incremental: поддерево добавлено к уже посчитанному, суммы правим на разницу.
+// Возвращает 0, если часть каталогов осталась без inotify.
+static int install_dirs_locked(struct attr_entry *e, struct scan_result *r,
+                               int incremental) {
+    int complete = r->complete;
+    for (size_t i = 0; i < r->count; i++) {
+        struct scan_dir *d = &r->dirs[i];
+        struct watched_dir *w = watch_get_locked(d->wd);
+
+        // Тот же inode уже отслеживается для другого пользователя
+        if (w && w->owner != e) {
+            atomic_fetch_sub(&watches_used, 1);
+            complete = 0;
+            continue;
+        }
+        if (d->wd < 0) {
+            if (incremental) {
+                e->usage_bytes += d->bytes;
+                e->usage_files += d->files;
+            }
+            complete = 0;
+            continue;
+        }
+
+        if (!w) {
+            w = calloc(1, sizeof(*w));
+            if (!w || watch_set_locked(d->wd, w) != 0) {
+                free(w);
+                inotify_rm_watch(inotify_fd, d->wd);
+                atomic_fetch_sub(&watches_used, 1);
+                complete = 0;
+                continue;
+            }
+            w->owner = e;
+        } else {
+            // Повторное inotify_add_watch того же каталога
+            atomic_fetch_sub(&watches_used, 1);
+            free(w->path);
+            w->path = NULL;
+            if (incremental) {
+                e->usage_bytes -= w->bytes;
+                e->usage_files -= w->files;
+            }
+        }
+        if (incremental) {
+            e->usage_bytes += d->bytes;
+            e->usage_files += d->files;
+        }
+
+        w->path = d->path;
+        d->path = NULL;
+        w->bytes = d->bytes;
+        w->files = d->files;
+        w->gen = e->scan_gen;
+    }
+    return complete;
+}
+
+// Снимает наблюдение с каталогов, которые не попали в обход generation gen
+static void drop_stale_watches_locked(struct attr_entry *e, int all, unsigned gen) {
+    for (int wd = 0; wd < watch_table_cap; wd++) {
+        struct watched_dir *w = watch_table[wd];
+        if (w && w->owner == e && (all || w->gen != gen))
+            watch_drop_locked(wd, 1);
+    }
+}
+
+// 0 — задание в очереди (новое или уже ожидающее), -1 — поставить не удалось
+static int enqueue_locked(struct attr_entry *e, int attr) {
+    if (attr == USER_ATTR_FILE_COUNT) attr = USER_ATTR_DISK_USAGE;
+    if (e->pending[attr]) return 0;
+    if (worker_count == 0 || queue_len == QUEUE_CAP) return -1;
+
+    struct attr_job *job = &queue[(queue_head + queue_len) % QUEUE_CAP];
+    job->name = strdup(e->name);
+    job->home = strdup(e->home);
+    if (!job->name || !job->home) {
+        free(job->name);
+        free(job->home);
+        return -1;
+    }
+    job->gid = e->gid;
+    job->attr = attr;
+
+    e->pending[attr] = 1;
+    queue_len++;
+    pthread_cond_signal(&queue_cond);
+    return 0;
+}
+
+static void refresh_if_stale_locked(struct attr_entry *e, int attr) {
+    if (attr == USER_ATTR_FILE_COUNT) attr = USER_ATTR_DISK_USAGE;
+
+    time_t now = time(NULL);
+    time_t ttl = ATTR_TTL;
+    if (attr == USER_ATTR_DISK_USAGE && e->watch_complete) ttl = USAGE_TTL;
+    if (now - e->updated[attr] < ttl) return;
+
+    // wtmp не менялся — последний вход тоже
+    if (attr == USER_ATTR_LAST_LOGIN) {
+        struct stat st;
+        if (stat(_PATH_WTMP, &st) == 0 && st.st_size == e->wtmp_size) {
+            e->updated[attr] = now;
+            return;
+        }
+    }
+    enqueue_locked(e, attr);
+}
+
+// Выполняет задание без блокировки; результат кладётся в кеш,
+// если пользователь за это время не был удалён
+static void run_job(struct attr_job *job) {
+    int attr = job->attr;
+    if (attr == USER_ATTR_FILE_COUNT) attr = USER_ATTR_DISK_USAGE;
+
+    if (attr == USER_ATTR_GROUPS) {
+        char *v = compute_groups(job->name, job->gid);
+        pthread_mutex_lock(&cache_lock);
+        struct attr_entry *e = entry_find_locked(job->name);
+        if (e) {
+            entry_set_value_locked(e, attr, v);
+            e->pending[attr] = 0;
+        } else {
+            free(v);
+        }
+        pthread_mutex_unlock(&cache_lock);
+        return;
+    }
+
+    if (attr == USER_ATTR_LAST_LOGIN) {
+        off_t size;
+        char *v = compute_last_login(job->name, &size);
+        pthread_mutex_lock(&cache_lock);
+        struct attr_entry *e = entry_find_locked(job->name);
+        if (e) {
+            entry_set_value_locked(e, attr, v);
+            e->wtmp_size = size;
+            e->pending[attr] = 0;
+        } else {
+            free(v);
+        }
+        pthread_mutex_unlock(&cache_lock);
+        return;
+    }
+
+    struct scan_result r;
+    memset(&r, 0, sizeof(r));
+    r.complete = 1;
+    scan_tree(job->home, &r);
+
+    pthread_mutex_lock(&cache_lock);
+    struct attr_entry *e = entry_find_locked(job->name);
+    if (e) {
+        unsigned gen = ++e->scan_gen;
+        e->watch_complete = install_dirs_locked(e, &r, 0);
+        drop_stale_watches_locked(e, 0, gen);
+        e->usage_bytes = r.bytes;
+        e->usage_files = r.files;
+        e->dev = r.dev;
+        entry_set_usage_locked(e);
+        e->pending[attr] = 0;
+    } else {
+        release_scan_watches_locked(&r);
+    }
+    pthread_mutex_unlock(&cache_lock);
+    scan_result_free(&r);
+}
+
+static void job_free(struct attr_job *job) {
+    free(job->name);
+    free(job->home);
+    job->name = job->home = NULL;
+}
+
+static void *worker_main(void *arg) {
+    (void) arg;
+    for (;;) {
+        pthread_mutex_lock(&cache_lock);
+        while (!atomic_load(&shutting_down) && queue_len == 0)
+            pthread_cond_wait(&queue_cond, &cache_lock);
+        if (atomic_load(&shutting_down)) {
+            pthread_mutex_unlock(&cache_lock);
+            return NULL;
+        }
+        struct attr_job job = queue[queue_head];
+        queue_head = (queue_head + 1) % QUEUE_CAP;
+        queue_len--;
+        pthread_mutex_unlock(&cache_lock);
+
+        run_job(&job);
+        job_free(&job);
+
+        // Будим read, ожидающие первого значения
+        pthread_cond_broadcast(&result_cond);
+    }
+}
+
+// =========================
+// Инкрементальный du через inotify
+// =========================
+
+// Пересчитывает только непосредственное содержимое одного каталога
+static void rescan_dir(int wd) {
+    pthread_mutex_lock(&cache_lock);
+    struct watched_dir *w = watch_get_locked(wd);
+    if (!w) {
+        pthread_mutex_unlock(&cache_lock);
+        return;
+    }
+    char *path = strdup(w->path);
+    dev_t dev = w->owner->dev;
+    pthread_mutex_unlock(&cache_lock);
+    if (!path) return;
+
+    unsigned long long bytes, files;
+    if (scan_dir_direct(path, dev, &bytes, &files, NULL) == 0) {
+        pthread_mutex_lock(&cache_lock);
+        w = watch_get_locked(wd);
+        if (w && strcmp(w->path, path) == 0) {
+            struct attr_entry *e = w->owner;
+            e->usage_bytes = e->usage_bytes - w->bytes + bytes;
+            e->usage_files = e->usage_files - w->files + files;
+            w->bytes = bytes;
+            w->files = files;
+            entry_set_usage_locked(e);
+        }
+        pthread_mutex_unlock(&cache_lock);
+    }
+    free(path);
+}
+
+static void add_subtree(int parent_wd, const char *name) {
+    pthread_mutex_lock(&cache_lock);
+    struct watched_dir *w = watch_get_locked(parent_wd);
+    if (!w) {
+        pthread_mutex_unlock(&cache_lock);
+        return;
+    }
+    char *path = path_join(w->path, name);
+    dev_t dev = w->owner->dev;
+    pthread_mutex_unlock(&cache_lock);
+    if (!path) return;
+
+    struct scan_result r;
+    memset(&r, 0, sizeof(r));
+    r.complete = 1;
+    r.has_dev = 1;
+    r.dev = dev;
+    scan_tree(path, &r);
+    free(path);
+
+    pthread_mutex_lock(&cache_lock);
+    w = watch_get_locked(parent_wd);
+    if (w) {
+        struct attr_entry *e = w->owner;
+        if (!install_dirs_locked(e, &r, 1)) e->watch_complete = 0;
+        entry_set_usage_locked(e);
+    } else {
+        release_scan_watches_locked(&r);
+    }
+    pthread_mutex_unlock(&cache_lock);
+    scan_result_free(&r);
+}
+
+// Полный пересчёт du пользователя, которому принадлежит wd
+static void schedule_rescan(int wd) {
+    pthread_mutex_lock(&cache_lock);
+    struct watched_dir *w = watch_get_locked(wd);
+    if (w) enqueue_locked(w->owner, USER_ATTR_DISK_USAGE);
+    pthread_mutex_unlock(&cache_lock);
+}
+
+static void *watcher_main(void *arg) {
+    (void) arg;
+    char buf[65536] __attribute__((aligned(__alignof__(struct inotify_event))));
+    int dirty[256];
+
+    struct pollfd fds[2] = {
+        { .fd = inotify_fd, .events = POLLIN },
+        { .fd = wake_fd, .events = POLLIN },
+    };
+
+    while (!atomic_load(&shutting_down)) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (fds[1].revents) break;
+
+        ssize_t len = read(inotify_fd, buf, sizeof(buf));
+        if (len <= 0) continue;
+
+        // Несколько событий в одном каталоге — один пересчёт
+        size_t ndirty = 0;
+        for (char *p = buf; p < buf + len;) {
+            struct inotify_event *ev = (struct inotify_event *)p;
+            p += sizeof(struct inotify_event) + ev->len;
+
+            if (ev->mask & IN_Q_OVERFLOW) {
+                pthread_mutex_lock(&cache_lock);
+                for (struct attr_entry *e = entries; e; e = e->next)
+                    if (e->value[USER_ATTR_DISK_USAGE])
+                        enqueue_locked(e, USER_ATTR_DISK_USAGE);
+                pthread_mutex_unlock(&cache_lock);
+                continue;
+            }
+
+            if (ev->mask & IN_DELETE_SELF) {
+                pthread_mutex_lock(&cache_lock);
+                struct watched_dir *w = watch_get_locked(ev->wd);
+                if (w) w->deleted = 1;
+                pthread_mutex_unlock(&cache_lock);
+                continue;
+            }
+
+            // Свои наблюдения мы убираем из таблицы до inotify_rm_watch,
+            // поэтому здесь — удалённый каталог, размонтирование или чужой rm
+            if (ev->mask & IN_IGNORED) {
+                pthread_mutex_lock(&cache_lock);
+                struct watched_dir *w = watch_get_locked(ev->wd);
+                if (w) {
+                    struct attr_entry *e = w->owner;
+                    e->usage_bytes -= w->bytes;
+                    e->usage_files -= w->files;
+                    // Каталог остался без наблюдения: дальше du — по ATTR_TTL
+                    if (!w->deleted) e->watch_complete = 0;
+                    watch_drop_locked(ev->wd, 0);
+                    entry_set_usage_locked(e);
+                }
+                pthread_mutex_unlock(&cache_lock);
+                continue;
+            }
+
+            // Переименованный каталог — пути в таблице устарели
+            if ((ev->mask & IN_MOVE_SELF) ||
+                ((ev->mask & IN_ISDIR) && (ev->mask & (IN_MOVED_FROM | IN_MOVED_TO)))) {
+                schedule_rescan(ev->wd);
+                continue;
+            }
+
+            if ((ev->mask & IN_ISDIR) && (ev->mask & IN_CREATE) && ev->len > 0)
+                add_subtree(ev->wd, ev->name);
+
+            size_t i;
+            for (i = 0; i < ndirty && dirty[i] != ev->wd; i++);
+            if (i < ndirty) continue;
+            if (ndirty == sizeof(dirty) / sizeof(dirty[0])) {
+                for (i = 0; i < ndirty; i++) rescan_dir(dirty[i]);
+                ndirty = 0;
+            }
+            dirty[ndirty++] = ev->wd;
+        }
+
+        for (size_t i = 0; i < ndirty; i++) rescan_dir(dirty[i]);
+    }
+    return NULL;
+}
+
+// =========================
+// Интерфейс для VFS
+// =========================
+
+int user_attr_lookup(const char *filename) {
+    for (int i = 0; i < USER_ATTR_COUNT; i++)
+        if (strcmp(filename, attr_names[i]) == 0) return i;
+    return -1;
+}
+
+const char *user_attr_name(int attr) {
+    if (attr < 0 || attr >= USER_ATTR_COUNT) return NULL;
+    return attr_names[attr];
+}
+
+int user_attr_read(const struct passwd *pwd, int attr,
+                   char *buf, size_t size, off_t offset) {
+    if (attr < 0 || attr >= USER_ATTR_COUNT) return -ENOENT;
+
+    pthread_mutex_lock(&cache_lock);
+    struct attr_entry *e = entry_get_locked(pwd);
+    if (!e) {
+        pthread_mutex_unlock(&cache_lock);
+        return -ENOMEM;
+    }
+
+    if (!e->value[attr]) {
+        // Первое обращение: считает пул, этот поток FUSE ждёт результат
+        // (задание, начатое через getattr, не дублируется; при полной
+        // очереди ждём, пока освободится место)
+        int job_attr = attr == USER_ATTR_FILE_COUNT ? USER_ATTR_DISK_USAGE : attr;
+        int queued = 0;
+        int ret = 0;
+        for (;;) {
+            e = entry_find_locked(pwd->pw_name);
+            if (!e) {
+                ret = -ENOENT;
+            } else if (e->value[attr]) {
+                break;
+            } else if (atomic_load(&shutting_down) || worker_count == 0) {
+                ret = -EIO;
+            } else if (!e->pending[job_attr]) {
+                // Наше задание завершилось без значения
+                if (queued) ret = -EIO;
+                else if (enqueue_locked(e, attr) == 0) queued = 1;
+                else if (queue_len < QUEUE_CAP) ret = -ENOMEM;
+            }
+            if (ret != 0) {
+                pthread_mutex_unlock(&cache_lock);
+                return ret;
+            }
+            if (!e->value[attr]) pthread_cond_wait(&result_cond, &cache_lock);
+        }
+    } else {
+        refresh_if_stale_locked(e, attr);
+    }
+
+    const char *content = e->value[attr];
+    size_t len = strlen(content);
+    int copied = 0;
+    if ((size_t)offset < len) {
+        size_t to_copy = len - offset;
+        if (to_copy > size) to_copy = size;
+        memcpy(buf, content + offset, to_copy);
+        copied = to_copy;
+    }
+    pthread_mutex_unlock(&cache_lock);
+    return copied;
+}
+
+off_t user_attr_size(const struct passwd *pwd, int attr, time_t *mtime) {
+    off_t size = 0;
+    *mtime = 0;
+    if (attr < 0 || attr >= USER_ATTR_COUNT) return 0;
+
+    pthread_mutex_lock(&cache_lock);
+    struct attr_entry *e = entry_get_locked(pwd);
+    if (e) {
+        if (e->value[attr]) {
+            size = strlen(e->value[attr]);
+            *mtime = e->updated[attr];
+            refresh_if_stale_locked(e, attr);
+        } else {
+            enqueue_locked(e, attr);
+        }
+    }
+    pthread_mutex_unlock(&cache_lock);
+    return size;
+}
+
+void user_attrs_forget(const char *username) {
+    pthread_mutex_lock(&cache_lock);
+    struct attr_entry **pp = &entries;
+    while (*pp && strcmp((*pp)->name, username) != 0) pp = &(*pp)->next;
+    struct attr_entry *e = *pp;
+    if (e) {
+        *pp = e->next;
+        drop_stale_watches_locked(e, 1, 0);
+        for (int i = 0; i < USER_ATTR_COUNT; i++) free(e->value[i]);
+        free(e->name);
+        free(e->home);
+        free(e);
+    }
+    pthread_mutex_unlock(&cache_lock);
+}
+
+int user_attrs_start(const char *mount_point) {
+    atomic_store(&shutting_down, 0);
+
+    // Запоминаем каталог, в котором будет точка монтирования (до монтирования)
+    char *real = mount_point ? realpath(mount_point, NULL) : NULL;
+    char *slash = real ? strrchr(real, '/') : NULL;
+    if (slash && slash[1] != '\0') {
+        struct stat st;
+        *slash = '\0';
+        if (stat(slash == real ? "/" : real, &st) == 0) {
+            mount_parent_dev = st.st_dev;
+            mount_parent_ino = st.st_ino;
+            mount_name = strdup(slash + 1);
+        }
+    }
+    free(real);
+
+    // Без inotify du просто пересчитывается по ATTR_TTL
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    wake_fd = eventfd(0, EFD_CLOEXEC);
+
+    // Сигналы должен получать только поток FUSE
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &old);
+
+    for (int i = 0; i < WORKER_COUNT; i++) {
+        if (pthread_create(&workers[worker_count], NULL, worker_main, NULL) == 0)
+            worker_count++;
+    }
+    if (inotify_fd >= 0 && wake_fd >= 0 &&
+        pthread_create(&watcher, NULL, watcher_main, NULL) == 0)
+        watcher_started = 1;
+
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    return worker_count > 0 ? 0 : -1;
+}
+
+void user_attrs_stop(void) {
+    pthread_mutex_lock(&cache_lock);
+    atomic_store(&shutting_down, 1);
+    pthread_cond_broadcast(&queue_cond);
+    pthread_cond_broadcast(&result_cond);
+    pthread_mutex_unlock(&cache_lock);
+
+    if (wake_fd >= 0) {
+        uint64_t one = 1;
+        if (write(wake_fd, &one, sizeof(one)) < 0) {
+            // поток наблюдателя всё равно завершится по shutting_down
+        }
+    }
+
+    for (int i = 0; i < worker_count; i++) pthread_join(workers[i], NULL);
+    worker_count = 0;
+    if (watcher_started) pthread_join(watcher, NULL);
+    watcher_started = 0;
+
+    while (queue_len > 0) {
+        job_free(&queue[queue_head]);
+        queue_head = (queue_head + 1) % QUEUE_CAP;
+        queue_len--;
+    }
+
+    while (entries) user_attrs_forget(entries->name);
+    free(watch_table);
+    watch_table = NULL;
+    watch_table_cap = 0;
+    free(mount_name);
+    mount_name = NULL;
+
+    if (inotify_fd >= 0) close(inotify_fd);
+    if (wake_fd >= 0) close(wake_fd);
+    inotify_fd = wake_fd = -1;
+}
@@ -0,0 +1,37 @@
+#ifndef USER_ATTRS_H
+#define USER_ATTRS_H
+
+#include <sys/types.h>
+#include <pwd.h>
+#include <time.h>
+
+// "Дорогие" атрибуты пользователя в VFS. Вычисляются при первом обращении,
+// дальше отдаются из кеша и обновляются в фоне пулом потоков.
+enum user_attr {
+    USER_ATTR_GROUPS,
+    USER_ATTR_DISK_USAGE,
+    USER_ATTR_FILE_COUNT,
+    USER_ATTR_LAST_LOGIN,
+    USER_ATTR_COUNT
+};
+
+// mount_point — точка монтирования VFS; обход домашних каталогов её пропускает
+int user_attrs_start(const char *mount_point);
+void user_attrs_stop(void);
+
+// Имя файла -> атрибут, -1 если такого нет
+int user_attr_lookup(const char *filename);
+const char *user_attr_name(int attr);
+
+// Читает значение; при промахе кеша ставит задание в пул и ждёт
+// его результат, сам дерево не обходит
+int user_attr_read(const struct passwd *pwd, int attr,
+                   char *buf, size_t size, off_t offset);
+
+// Размер по кешу (возможно устаревший), никогда не блокирует
+off_t user_attr_size(const struct passwd *pwd, int attr, time_t *mtime);
+
+// Забыть пользователя (после удаления)
+void user_attrs_forget(const char *username);
+
+#endif
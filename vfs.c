@@ -14,10 +14,15 @@
 #include <signal.h>
 #include <limits.h>
 #include <time.h>
+#include <pthread.h>
+
+#include "user_attrs.h"
 
 static int vfs_pid = -1;
 static struct passwd **users = NULL;
 static int user_count = 0;
+// FUSE работает в несколько потоков: mkdir/rmdir пересобирают users
+static pthread_rwlock_t users_lock = PTHREAD_RWLOCK_INITIALIZER;
 
 int get_users_list() {
     // Освобождаем старый список если есть
@@ -104,13 +109,7 @@ void free_users_list() {
     }
 }
 
-static int users_readdir(const char *path, void *buf, fuse_fill_dir_t filler,
-                         off_t offset, struct fuse_file_info *fi,
-                         enum fuse_readdir_flags flags) {
-    (void) offset;
-    (void) fi;
-    (void) flags;
-    
+static int users_readdir_locked(const char *path, void *buf, fuse_fill_dir_t filler) {
     // Корневой каталог
     if (strcmp(path, "/") == 0) {
         filler(buf, ".", NULL, 0, 0);
@@ -137,6 +136,9 @@ static int users_readdir(const char *path, void *buf, fuse_fill_dir_t filler,
                 filler(buf, "id", NULL, 0, 0);
                 filler(buf, "home", NULL, 0, 0);
                 filler(buf, "shell", NULL, 0, 0);
+                for (int a = 0; a < USER_ATTR_COUNT; a++) {
+                    filler(buf, user_attr_name(a), NULL, 0, 0);
+                }
                 return 0;
             }
         }
@@ -145,8 +147,29 @@ static int users_readdir(const char *path, void *buf, fuse_fill_dir_t filler,
     return -ENOENT;
 }
 
-static int users_open(const char *path, struct fuse_file_info *fi) {
+static int users_readdir(const char *path, void *buf, fuse_fill_dir_t filler,
+                         off_t offset, struct fuse_file_info *fi,
+                         enum fuse_readdir_flags flags) {
+    (void) offset;
     (void) fi;
+    (void) flags;
+    
+    pthread_rwlock_rdlock(&users_lock);
+    int ret = users_readdir_locked(path, buf, filler);
+    pthread_rwlock_unlock(&users_lock);
+    return ret;
+}
+
+static int users_open(const char *path, struct fuse_file_info *fi) {
+    char username[NAME_MAX];
+    char filename[NAME_MAX];
+    
+    // Размер кешируемых атрибутов может быть устаревшим,
+    // поэтому читаем их в обход page cache
+    if (sscanf(path, "/%255[^/]/%255s", username, filename) == 2 &&
+        user_attr_lookup(filename) >= 0) {
+        fi->direct_io = 1;
+    }
     return 0;
 }
 
@@ -161,6 +184,8 @@ static int users_read(const char *path, char *buf, size_t size, off_t offset,
         return -ENOENT;
     }
     
+    pthread_rwlock_rdlock(&users_lock);
+    
     // Ищем пользователя
     struct passwd *pwd = NULL;
     for (int i = 0; i < user_count; i++) {
@@ -171,11 +196,13 @@ static int users_read(const char *path, char *buf, size_t size, off_t offset,
     }
     
     if (!pwd) {
+        pthread_rwlock_unlock(&users_lock);
         return -ENOENT;
     }
     
     const char *content = NULL;
     char id_buf[32];
+    int attr = user_attr_lookup(filename);
     
     if (strcmp(filename, "id") == 0) {
         snprintf(id_buf, sizeof(id_buf), "%d", pwd->pw_uid);
@@ -184,7 +211,23 @@ static int users_read(const char *path, char *buf, size_t size, off_t offset,
         content = pwd->pw_dir;
     } else if (strcmp(filename, "shell") == 0) {
         content = pwd->pw_shell;
+    } else if (attr >= 0) {
+        // Первое чтение ждёт пул потоков: список пользователей не держим
+        struct passwd copy = *pwd;
+        copy.pw_name = strdup(pwd->pw_name);
+        copy.pw_dir = strdup(pwd->pw_dir ? pwd->pw_dir : "");
+        copy.pw_passwd = copy.pw_gecos = copy.pw_shell = NULL;
+        pthread_rwlock_unlock(&users_lock);
+        
+        int ret = -ENOMEM;
+        if (copy.pw_name && copy.pw_dir) {
+            ret = user_attr_read(&copy, attr, buf, size, offset);
+        }
+        free(copy.pw_name);
+        free(copy.pw_dir);
+        return ret;
     } else {
+        pthread_rwlock_unlock(&users_lock);
         return -ENOENT;
     }
     
@@ -193,23 +236,20 @@ static int users_read(const char *path, char *buf, size_t size, off_t offset,
     }
     
     size_t len = strlen(content);
-    if ((size_t)offset >= len) {
-        return 0;
-    }
-    
-    size_t to_copy = len - offset;
-    if (to_copy > size) {
-        to_copy = size;
+    size_t to_copy = 0;
+    if ((size_t)offset < len) {
+        to_copy = len - offset;
+        if (to_copy > size) {
+            to_copy = size;
+        }
+        memcpy(buf, content + offset, to_copy);
     }
     
-    memcpy(buf, content + offset, to_copy);
+    pthread_rwlock_unlock(&users_lock);
     return to_copy;
 }
 
-static int users_getattr(const char *path, struct stat *stbuf,
-                         struct fuse_file_info *fi) {
-    (void) fi;
-    
+static int users_getattr_locked(const char *path, struct stat *stbuf) {
     memset(stbuf, 0, sizeof(struct stat));
     stbuf->st_uid = getuid();
     stbuf->st_gid = getgid();
@@ -262,6 +302,19 @@ static int users_getattr(const char *path, struct stat *stbuf,
                             }
                             return 0;
                         }
+                        
+                        int attr = user_attr_lookup(filename);
+                        if (attr >= 0) {
+                            // Не блокирует: размер из кеша, пересчёт в фоне
+                            time_t mtime;
+                            stbuf->st_mode = S_IFREG | 0444;
+                            stbuf->st_nlink = 1;
+                            stbuf->st_size = user_attr_size(users[i], attr, &mtime);
+                            if (mtime) {
+                                stbuf->st_mtime = stbuf->st_ctime = mtime;
+                            }
+                            return 0;
+                        }
                     }
                 }
             }
@@ -271,11 +324,19 @@ static int users_getattr(const char *path, struct stat *stbuf,
     return -ENOENT;
 }
 
+static int users_getattr(const char *path, struct stat *stbuf,
+                         struct fuse_file_info *fi) {
+    (void) fi;
+    
+    pthread_rwlock_rdlock(&users_lock);
+    int ret = users_getattr_locked(path, stbuf);
+    pthread_rwlock_unlock(&users_lock);
+    return ret;
+}
+
 // ... предыдущий код без изменений ...
 
-static int users_mkdir(const char *path, mode_t mode) {
-    (void) mode;
-    
+static int users_mkdir_locked(const char *path) {
     char username[NAME_MAX];
     if (sscanf(path, "/%255[^/]", username) != 1) {
         return -EINVAL;
@@ -315,7 +376,7 @@ static int users_mkdir(const char *path, mode_t mode) {
     return ret == 0 ? 0 : -EIO;
 }
 
-static int users_rmdir(const char *path) {
+static int users_rmdir_locked(const char *path) {
     char username[NAME_MAX];
     if (sscanf(path, "/%255[^/]", username) != 1) {
         return -EINVAL;
@@ -365,12 +426,29 @@ static int users_rmdir(const char *path) {
     
     if (ret == 0) {
         // Обновляем список пользователей
+        user_attrs_forget(username);
         get_users_list();
     }
     
     return ret == 0 ? 0 : -EIO;
 }
 
+static int users_mkdir(const char *path, mode_t mode) {
+    (void) mode;
+    
+    pthread_rwlock_wrlock(&users_lock);
+    int ret = users_mkdir_locked(path);
+    pthread_rwlock_unlock(&users_lock);
+    return ret;
+}
+
+static int users_rmdir(const char *path) {
+    pthread_rwlock_wrlock(&users_lock);
+    int ret = users_rmdir_locked(path);
+    pthread_rwlock_unlock(&users_lock);
+    return ret;
+}
+
 // ... остальной код без изменений ...
 
 static struct fuse_operations users_oper = {
@@ -389,10 +467,11 @@ int start_users_vfs(const char *mount_point) {
     int pid = fork();    
     if (pid == 0) {
         // Дочерний процесс
+        // Без -s: первое чтение дорогого атрибута ждёт пул потоков
+        // и не должно задерживать остальные запросы к точке монтирования
         char *fuse_argv[] = {
             "users_vfs",        // имя программы
             "-f",               // foreground mode
-            "-s",               // single-threaded
             (char*)mount_point, // точка монтирования
             NULL
         };
@@ -403,10 +482,15 @@ int start_users_vfs(const char *mount_point) {
             exit(1);
         }
         
+        // Фоновый пул для groups/disk_usage/file_count/last_login;
+        // точку монтирования он обходит стороной
+        user_attrs_start(mount_point);
+        
         // Запускаем FUSE
-        int ret = fuse_main(4, fuse_argv, &users_oper, NULL);
+        int ret = fuse_main(3, fuse_argv, &users_oper, NULL);
         
         // Очищаем перед выходом
+        user_attrs_stop();
         free_users_list();
         exit(ret);
     } else if (pid > 0) { 